@@ -10,9 +10,15 @@
 #include <QThread>
 #include <QCoreApplication>
 
+#include "archivestream.h"
 #include "botan_all.h"
 #include "messages.h"
+#include "chunkpipeline.h"
 #include "cryptoengine.h"
+#include "directorywalker.h"
+#include "fileheader.h"
+#include "journal.h"
+#include "jobscheduler.h"
 #include "utils.h"
 #include <iostream>
 
@@ -31,10 +37,18 @@ void Crypto_Thread::setParam(bool direction,
                              quint32 argoniter,
                              bool deletefile)
 {
-    m_filenames  = filenames;
-    m_password   = password;
-    m_direction  = direction;
-    m_deletefile = deletefile;
+    // the cached keys belong to the previous password
+    if (password != m_password)
+        m_keyCache.clear();
+
+    m_filenames   = filenames;
+    m_password    = password;
+    m_direction   = direction;
+    m_deletefile  = deletefile;
+    m_rangeOffset = 0;
+    m_rangeLength = -1;
+    m_archive.clear();
+    m_extract.clear();
 
     if (argonmem == 0)
         m_argonmem = m_const->MEMLIMIT_INTERACTIVE;
@@ -55,55 +69,176 @@ void Crypto_Thread::setParam(bool direction,
         m_argoniter = m_const->ITERATION_SENSITIVE;
 }
 
+void Crypto_Thread::setThreads(quint32 threads)
+{
+    m_threads = threads;
+}
+
+void Crypto_Thread::setRange(qint64 offset, qint64 length)
+{
+    m_rangeOffset = offset;
+    m_rangeLength = length;
+}
+
+void Crypto_Thread::setArchive(const QString& archive)
+{
+    m_archive = archive;
+}
+
+void Crypto_Thread::setExtract(const QString& member)
+{
+    m_extract = member.isEmpty() ? member : QDir::cleanPath(member);
+}
+
+void Crypto_Thread::setChunkSize(quint32 chunkSize)
+{
+    m_chunkSize = chunkSize == 0 ? 0 : qBound(m_const->MIN_CHUNK_SIZE, chunkSize, m_const->MAX_CHUNK_SIZE);
+}
+
+void Crypto_Thread::setCompression(quint32 codec)
+{
+    m_compression = codec == m_const->COMPRESSION_ZLIB ? codec : m_const->COMPRESSION_NONE;
+}
+
+void Crypto_Thread::setResumable(bool resumable)
+{
+    m_resumable = resumable;
+}
+
+void Crypto_Thread::setNamePadding(quint32 bucket)
+{
+    m_namePadding = qMin(bucket, m_const->NAME_PADDING_MAX);
+}
+
+void Crypto_Thread::setParallelism(quint32 lanes)
+{
+    m_parallelism = qBound(1u, lanes, m_const->PARALLELISM_MAX);
+}
+
+bool Crypto_Thread::setArgonParameters(quint32 memlimit, quint32 iterations, quint32 lanes)
+{
+    if (!FileHeader::validArgon(memlimit, iterations, lanes))
+        return (false);
+
+    m_argonmem    = memlimit;
+    m_argoniter   = iterations;
+    m_parallelism = lanes;
+    return (true);
+}
+
+void Crypto_Thread::setConcurrency(quint32 files)
+{
+    m_concurrency = files;
+}
+
+void Crypto_Thread::setArgonMemoryBudget(quint64 memory)
+{
+    m_argonBudget = memory;
+}
+
+void Crypto_Thread::setMemoryBudget(quint64 memory)
+{
+    m_memoryBudget = memory;
+}
+
+void Crypto_Thread::setBatchMode(bool batch)
+{
+    m_batchMode = batch;
+}
+
+quint64 Crypto_Thread::derivations() const
+{
+    return (m_derivations);
+}
+
+void Crypto_Thread::clearKeys()
+{
+    m_keyCache.clear();
+}
+
+void Crypto_Thread::setMemoryMapped(bool mapped)
+{
+    m_memoryMapped = mapped;
+}
+
+void Crypto_Thread::setDirectIo(bool direct)
+{
+    m_directIo = direct;
+}
+
+void Crypto_Thread::setIoDepth(quint32 depth)
+{
+    m_ioDepth = depth;
+}
+
 void Crypto_Thread::run()
 {
+    // one master key salt for the whole job, the cache runs Argon2 once for it
+    AutoSeeded_RNG rng;
+    m_batchSalt = rng.random_vec(m_const->ARGON_SALT_LEN);
+    m_keyCache.setMemoryBudget(m_argonBudget);
+    const auto derivations = m_keyCache.derivations();
 
-    for (auto& inputFileName : m_filenames) {
-        if (m_aborted) {
-            m_aborted = true;
-            Crypto_Thread::terminate();
-            return;
-        }
+    const auto ideal       = static_cast<quint32>(QThread::idealThreadCount());
+    const auto threads     = m_threads > 0 ? m_threads : ideal;
+    const auto concurrency = m_concurrency > 0 ? m_concurrency : ideal;
 
-        QFile src_file(QDir::cleanPath(inputFileName));
-        QFileInfo src_info(src_file);
-        if (!src_file.exists() || !src_info.isFile()) {
-            emit statusMessage("SRC_CANNOT_OPEN_READ");
-            return;
-        }
+    // at most that many chunk workers run at once, see JobScheduler
+    m_budgetThreads = qMax(threads, concurrency);
+    m_peakMemory    = 0;
 
-        if (!src_file.open(QIODevice::ReadOnly)) {
-            emit statusMessage("SRC_CANNOT_OPEN_READ");
-            return;
-        }
+    const auto process = [this](const QString& inputFileName, quint32 chunkThreads) {
+        const auto operation = m_direction ? " encryption of " : " decryption of ";
+        emit statusMessage("");
+        emit statusMessage(QDateTime::currentDateTime().toString("dddd dd MMMM yyyy (hh:mm:ss)") + operation + inputFileName);
 
-        if (m_direction == true) {
-            emit statusMessage("");
-            emit statusMessage(QDateTime::currentDateTime().toString("dddd dd MMMM yyyy (hh:mm:ss)") + " encryption of " + inputFileName);
-            quint32 result = 0;
-            result         = encrypt(inputFileName);
+        const auto result = m_direction ? encrypt(inputFileName, chunkThreads) : decrypt(inputFileName, chunkThreads);
 
-            emit statusMessage(errorCodeToString(result));
+        // several files may run at once, say which one this is about
+        emit statusMessage(QFileInfo(inputFileName).fileName() + ": " + errorCodeToString(result));
+    };
 
-            if (m_aborted) {
-                m_aborted = false; // Reset abort flag
-                return;
-            }
-        }
-        else {
-            emit statusMessage("");
-            emit statusMessage(QDateTime::currentDateTime().toString("dddd dd MMMM yyyy (hh:mm:ss)") + " decryption of " + inputFileName);
-            quint32 result = decrypt(inputFileName);
-            emit statusMessage(errorCodeToString(result));
+    JobScheduler scheduler(concurrency, threads);
+    scheduler.setAbortCallback([this] { return m_aborted.load(); });
+    scheduler.setErrorCallback([this](const QString& inputFileName, const QString& reason) {
+        emit statusMessage(QFileInfo(inputFileName).fileName() + ": " + reason);
+    });
 
-            if (m_aborted) {
-                m_aborted = false; // Reset abort flag
-            }
-        }
+    if (m_direction && !m_archive.isEmpty()) {
+        emit statusMessage("");
+        emit statusMessage(QDateTime::currentDateTime().toString("dddd dd MMMM yyyy (hh:mm:ss)") + " archiving in " + m_archive);
+
+        const auto result = encryptArchive(threads);
+        emit statusMessage(QFileInfo(m_archive).fileName() + ": " + errorCodeToString(result));
+    }
+    else if (DirectoryWalker::hasDirectory(m_filenames)) {
+        // the files of the trees are encrypted in place, next to the
+        // original, and decrypted next to the .arsn: the tree is kept
+        ChunkQueue<QString> files(m_const->WALKER_QUEUE_SIZE);
+        DirectoryWalker walker;
+        walker.setFilter([this](const QFileInfo& info) {
+            return (info.fileName().endsWith(m_const->DEFAULT_EXTENSION) != m_direction);
+        });
+        walker.start(m_filenames, files);
+        scheduler.run(files, process);
+        walker.wait();
     }
+    else {
+        scheduler.run(m_filenames, process);
+    }
+
+    m_aborted = false; // Reset abort flag
+
+    // the keys stay cached for the next job with this password, see clearKeys
+    m_derivations = m_keyCache.derivations() - derivations;
+
+    m_budgetThreads = 0;
+    if (m_peakMemory > 0)
+        emit statusMessage("chunk buffers: " + Utils::getFileSize(static_cast<qint64>(m_peakMemory.load())) + " at most"
+                           + (m_memoryBudget > 0 ? " of a " + Utils::getFileSize(static_cast<qint64>(m_memoryBudget)) + " budget" : QString()));
 }
 
-quint32 Crypto_Thread::encrypt(const QString& src_path)
+quint32 Crypto_Thread::encrypt(const QString& src_path, quint32 threads)
 {
 
     /* format is:
@@ -111,44 +246,30 @@ quint32 Crypto_Thread::encrypt(const QString& src_path)
      * APP_VERSION
      * Argon memlimit
      * Argon iterations
-     * original fileNameSize
-     * original fileSize
+     * chunkSize (since 4.1.0, IN_BUFFER_SIZE before)
+     * Argon lanes (since 4.2.0, 1 before)
+     * key mode (since 4.3.0, KEY_MODE_PASSWORD before)
+     * compression (since 4.7.0, COMPRESSION_NONE before)
+     * name block size (since 4.5.0, original fileNameSize before)
+     * original fileSize (STREAM_FILE_SIZE for a stream)
      * Argon salt  (16 bytes)
+     * file salt  (16 bytes, KEY_MODE_MASTER only)
      * ivChaCha20 +  ivAES +  ivSerpent (24 bytes *3)
-     * encrypted HeaderOriginalFileName  ( fileNameSize + randomBloc(IN_BUFFER_SIZE) + MACBYTES*3 )
-     * encrypted dataBlock1  ( IN_BUFFER_SIZE + MACBYTES*3 )
-     * encrypted dataBlock2  ( IN_BUFFER_SIZE + MACBYTES*3 )
+     * encrypted name block  ( name length + name + padding to a bucket + MACBYTES*3 )
+     *     ( fileNameSize + randomBloc(IN_BUFFER_SIZE) + MACBYTES*3 before 4.5.0 )
+     * encrypted dataBlock1  ( chunkSize + MACBYTES*3 )
+     * encrypted dataBlock2  ( chunkSize + MACBYTES*3 )
      * ...
      * ...
+     * the last block of a stream is always short, empty if needed
+     *
+     * when compressed, each data block is preceded by its length (quint32),
+     * its plaintext is a CHUNK_* flag and the (maybe compressed) data, and
+     * an encrypted CHUNK_END flag closes the file
      */
 
     QFile src_file(QDir::cleanPath(src_path));
     QFileInfo src_info(src_file);
-    const auto fileSize     = src_info.size();
-    const auto fileName     = src_info.fileName().toUtf8();
-    const auto fileNameSize = fileName.size();
-
-    AutoSeeded_RNG rng;
-    auto argonSalt   = rng.random_vec(m_const->ARGON_SALT_LEN);
-    auto tripleNonce = rng.random_vec(m_const->CIPHER_IV_LEN * 3);
-
-    const auto randomData = rng.random_vec(m_const->IN_BUFFER_SIZE);
-
-    // Append the file name to the buffer and some random data
-    SecureVector<quint8> master_buffer(fileName.size() + randomData.size());
-    memcpy(master_buffer.data(), fileName.data(), fileNameSize);
-    memcpy(master_buffer.data() + fileNameSize, randomData.data(), randomData.size());
-
-    // encryption of the buffer who contain the original name of the file
-    // and some random data
-
-    CryptoEngine encrypt(true);
-    encrypt.setSalt(argonSalt);
-    emit statusMessage("Argon2 passphrase derivation... Please wait.");
-
-    encrypt.derivePassword(m_password, m_argonmem, m_argoniter);
-    encrypt.setNonce(tripleNonce);
-    encrypt.finish(master_buffer);
 
     if (!src_file.exists() || !src_info.isFile())
         return (SRC_CANNOT_OPEN_READ);
@@ -157,139 +278,275 @@ quint32 Crypto_Thread::encrypt(const QString& src_path)
 
     // create the new file.
     QFile des_file(src_path + m_const->DEFAULT_EXTENSION);
+    Journal journal;
+    journal.path = Journal::pathFor(des_file.fileName());
+
+    // an output with a journal is the one of an interrupted run
+    auto resume = false;
+    if (m_resumable && des_file.exists() && journal.load()) {
+        resume = journal.direction && journal.matches(src_info);
+        if (!resume)
+            emit statusMessage(src_info.fileName() + " changed since " + journal.path + " was written, remove both to start over");
+    }
 
-    if (des_file.exists())
+    if (des_file.exists() && !resume)
         return (DES_FILE_EXISTS);
-    if (!des_file.open(QIODevice::WriteOnly))
+    // a writable shared mapping needs the fd open for reading too
+    if (!des_file.open(resume || m_memoryMapped ? QIODevice::ReadWrite : QIODevice::WriteOnly))
         return (DES_CANNOT_OPEN_WRITE);
 
-    QDataStream des_stream(&des_file);
-    des_stream.setVersion(QDataStream::Qt_5_0);
-
-    // Write a "magic number" , arsenic version, argon2 parameters, etc...
-    des_stream << static_cast<quint32>(m_const->MAGIC_NUMBER);
-    des_stream << static_cast<QVersionNumber>(m_const->APP_VERSION);
-    des_stream << static_cast<quint32>(m_argonmem);
-    des_stream << static_cast<quint32>(m_argoniter);
-    des_stream << static_cast<qint64>(fileNameSize);
-    des_stream << static_cast<qint64>(fileSize);
-
-    // Write the salt, the 3 nonces and the encrypted header in the file
-    des_stream.writeRawData(reinterpret_cast<char*>(argonSalt.data()), m_const->ARGON_SALT_LEN);
-    des_stream.writeRawData(reinterpret_cast<char*>(tripleNonce.data()), m_const->CIPHER_IV_LEN * 3);
-    des_stream.writeRawData(reinterpret_cast<char*>(master_buffer.data()), master_buffer.size());
+    if (m_resumable && !resume) {
+        journal.direction = true;
+        journal.output    = des_file.fileName();
+        journal.chunks    = 0;
+        journal.setSource(src_info);
+    }
 
-    // now, move on to the actual data
-    QDataStream src_stream(&src_file);
-    auto processed  = 0.;
-    auto bytes_read = 0;
-    SecureVector<quint8> inBuf(m_const->IN_BUFFER_SIZE);
-
-    while (!m_aborted && (bytes_read = src_stream.readRawData(reinterpret_cast<char*>(inBuf.data()), m_const->IN_BUFFER_SIZE)) > 0) {
-        // calculate percentage proccessed
-        processed += bytes_read;
-        emit updateProgress(src_info.filePath(), (processed / fileSize) * 100);
-        // ...
-        inBuf.resize(bytes_read);
-        encrypt.finish(inBuf);
-        des_stream.writeRawData(reinterpret_cast<char*>(inBuf.data()), inBuf.size());
-        inBuf.resize(m_const->IN_BUFFER_SIZE);
-    }
-
-    if (m_aborted) {
-        emit updateProgress(src_info.filePath(), 0);
+    const auto result = encryptDevice(src_file, des_file, src_info.fileName(), src_info.size(), m_batchMode, threads, src_info.filePath(), m_resumable ? &journal : nullptr);
+    if (result != CRYPT_SUCCESS) {
+        if (result == ABORTED_BY_USER)
+            emit updateProgress(src_info.filePath(), 0);
         des_file.close();
-        des_file.remove();
-        return (ABORTED_BY_USER);
+
+        // the blocks of the last checkpoint are kept for the next run
+        if (journal.chunks == 0) {
+            des_file.remove();
+            if (m_resumable)
+                journal.remove();
+        }
+        return (result);
+    }
+
+    // a resumed run may leave bytes written after the checkpoint
+    if (m_resumable) {
+        des_file.resize(des_file.pos());
+        journal.remove();
     }
 
     if (m_deletefile) {
-        QFile::remove(fileName);
-        emit deletedAfterSuccess(fileName);
+        src_file.close();
+        src_file.remove();
+        emit deletedAfterSuccess(src_path);
     }
     emit addEncrypted(des_file.fileName());
     return (CRYPT_SUCCESS);
 }
 
-quint32 Crypto_Thread::decrypt(const QString& src_path)
+quint32 Crypto_Thread::encryptStream(QIODevice& src, QIODevice& des)
 {
-    QFile src_file(QDir::cleanPath(src_path));
-    QFileInfo src_info(src_file);
-    QString absolutePath = src_info.absolutePath();
+    const auto threads = m_threads > 0 ? m_threads : static_cast<quint32>(QThread::idealThreadCount());
+    return (encryptDevice(src, des, QString(), m_const->STREAM_FILE_SIZE, false, threads, QString(), nullptr));
+}
 
-    if (!src_file.exists() || !src_info.isFile())
-        return (SRC_CANNOT_OPEN_READ);
+quint32 Crypto_Thread::encryptDevice(QIODevice& src,
+                                     QIODevice& des,
+                                     const QString& name,
+                                     qint64 fileSize,
+                                     bool batch,
+                                     quint32 threads,
+                                     const QString& progressPath,
+                                     Journal* journal)
+{
+    const auto streamed     = fileSize == m_const->STREAM_FILE_SIZE;
+
+    FileHeader header;
+    SecureVector<quint8> key;
+    SecureVector<quint8> state(m_const->TAG_STATE_LEN);
+    quint64 done = 0;
+
+    if (journal && journal->chunks > 0) {
+        // the header and the blocks of the last checkpoint are in des: the
+        // same key and nonces continue after them
+        QString original;
+        const auto opened = des.seek(0) ? readHeader(des, header, key, original) : SRC_HEADER_READ_ERROR;
+        if (opened != DECRYPT_SUCCESS || original != name || header.fileSize != fileSize) {
+            emit statusMessage("cannot resume " + name + ": " + errorCodeToString(opened == DECRYPT_SUCCESS ? SRC_HEADER_READ_ERROR : opened));
+            return (DES_FILE_EXISTS);
+        }
 
-    if (!src_file.open(QIODevice::ReadOnly))
-        return (SRC_CANNOT_OPEN_READ);
+        done = journal->chunks;
+        if (!ChunkPipeline::replayTags(des, done, header.chunkSize, header.compressed(), state) || state != journal->state ||
+            !src.seek(static_cast<qint64>(done) * header.chunkSize)) {
+            emit statusMessage("cannot resume " + name + ": " + journal->path + " doesn't match it, remove both to start over");
+            return (DES_FILE_EXISTS);
+        }
+        emit statusMessage("resuming " + name + " after " + Utils::getFileSize(static_cast<qint64>(done) * header.chunkSize));
+    }
+    else {
+        const auto written = encryptHeader(des, header, key, name, fileSize, batch);
+        if (written != CRYPT_SUCCESS)
+            return (written);
+    }
 
-    // open the source file and extract all informations necessary for decryption
-    QDataStream src_stream(&src_file);
-    src_stream.setVersion(QDataStream::Qt_5_0);
+    // now, move on to the actual data. Every chunk has its own nonce, so the
+    // chunks are encrypted in parallel and written back in order
+    ChunkPipeline pipeline(true, key, threads);
+    pipeline.setChunkSize(header.chunkSize);
+    pipeline.setMemoryMapped(m_memoryMapped);
+    pipeline.setDirectIo(m_directIo);
+    pipeline.setIoDepth(m_ioDepth);
+    pipeline.setFinalChunk(streamed);
+    pipeline.setCompression(header.compression);
+    if (!streamed) {
+        const auto base = static_cast<qint64>(done) * header.chunkSize;
+        pipeline.setProgressCallback([&, base](qint64 processed) {
+            emit updateProgress(progressPath, (static_cast<double>(base + processed) / fileSize) * 100);
+        });
+    }
+    pipeline.setAbortCallback([this] { return m_aborted.load(); });
+    if (journal)
+        setCheckpoint(pipeline, des, *journal, header.chunkSize, state);
+
+    const auto result = runPipeline(pipeline, src, des, header.tripleNonce, done + 1);
+    if (result != CRYPT_SUCCESS)
+        return (result);
+
+    return (m_aborted ? ABORTED_BY_USER : CRYPT_SUCCESS);
+}
 
+quint32 Crypto_Thread::encryptHeader(QIODevice& des, FileHeader& header, SecureVector<quint8>& key, const QString& name, qint64 fileSize, bool batch)
+{
+    const auto fileName     = name.toUtf8();
+    const auto fileNameSize = fileName.size();
+    const auto streamed     = fileSize == m_const->STREAM_FILE_SIZE;
+
+    // in a batch every file shares the Argon2 salt of the job and has its own
+    // HKDF salt, so Argon2 only runs for the first file
+    AutoSeeded_RNG rng;
+    header.memlimit    = m_argonmem;
+    header.iterations  = m_argoniter;
+    header.chunkSize   = m_chunkSize > 0 ? m_chunkSize : streamed ? m_const->STREAM_CHUNK_SIZE : ChunkPipeline::adaptiveChunkSize(fileSize);
+    header.parallelism = m_parallelism;
+    header.keyMode     = batch ? m_const->KEY_MODE_MASTER : m_const->KEY_MODE_PASSWORD;
+    header.compression = m_compression;
+    header.fileSize    = fileSize;
+    header.argonSalt   = batch ? m_batchSalt : rng.random_vec(m_const->ARGON_SALT_LEN);
+    header.fileSalt    = rng.random_vec(m_const->FILE_SALT_LEN);
+    header.tripleNonce = rng.random_vec(m_const->CIPHER_IV_LEN * 3);
+
+    // the length of the name and the name, padded with zeros to the bucket:
+    // once encrypted, the padding can't be told from the name
+    const auto nameBlock = m_const->NAME_LENGTH_LEN + fileNameSize;
+    const auto blockSize = m_namePadding > 0 ? (nameBlock + m_namePadding - 1) / m_namePadding * m_namePadding : nameBlock;
+
+    SecureVector<quint8> master_buffer(blockSize);
+    master_buffer[0] = static_cast<quint8>(fileNameSize >> 8);
+    master_buffer[1] = static_cast<quint8>(fileNameSize);
+    memcpy(master_buffer.data() + m_const->NAME_LENGTH_LEN, fileName.data(), fileNameSize);
+    header.fileNameSize = master_buffer.size();
+
+    // encryption of the buffer who contain the original name of the file
+    if (!m_keyCache.contains(header.argonSalt, m_argonmem, m_argoniter, m_parallelism))
+        emit statusMessage("Argon2 passphrase derivation... Please wait.");
+
+    // outside of a batch the salt is never seen again, nothing to cache
+    SecureVector<quint8> argonKey;
+    if (!deriveKey(argonKey, header.argonSalt, m_argonmem, m_argoniter, m_parallelism, batch))
+        return (KEY_DERIVATION_FAIL);
+
+    CryptoEngine encrypt(true);
+    if (header.keyMode == m_const->KEY_MODE_MASTER)
+        encrypt.deriveFileKey(argonKey, header.fileSalt);
+    else
+        encrypt.setKey(argonKey);
+    encrypt.setNonce(header.tripleNonce);
+    encrypt.finish(master_buffer);
+
+    // Write a "magic number" , arsenic version, argon2 parameters, etc...
+    // then the encrypted name block
+    QDataStream des_stream(&des);
+    des_stream.setVersion(QDataStream::Qt_5_0);
+    header.write(des_stream);
+    des_stream.writeRawData(reinterpret_cast<char*>(master_buffer.data()), master_buffer.size());
+    key = encrypt.key();
+    return (CRYPT_SUCCESS);
+}
+
+bool Crypto_Thread::deriveKey(SecureVector<quint8>& key, const SecureVector<quint8>& salt, quint32 memlimit, quint32 iterations, quint32 parallelism, bool keep)
+{
+    // std::bad_alloc on a small machine, nothing may leave a worker thread
+    try {
+        key = m_keyCache.key(m_password, salt, memlimit, iterations, parallelism, keep);
+    }
+    catch (const std::exception& e) {
+        emit statusMessage("Argon2 passphrase derivation failed: " + QString::fromLocal8Bit(e.what()));
+        return (false);
+    }
+    return (true);
+}
+
+void Crypto_Thread::setCheckpoint(ChunkPipeline& pipeline, QIODevice& des, Journal& journal, quint32 chunkSize, const SecureVector<quint8>& state)
+{
+    auto* file = qobject_cast<QFileDevice*>(&des);
+    pipeline.setCheckpointCallback(
+        [&journal, file](quint64 chunks, const SecureVector<quint8>& chain) {
+            // the journal never gets ahead of the data on the disk
+            if (!file || !Utils::syncFile(*file))
+                return;
+            auto next   = journal;
+            next.chunks = chunks;
+            next.state  = chain;
+            if (next.save())
+                journal = next;
+        },
+        m_const->JOURNAL_INTERVAL / chunkSize, state);
+}
+
+quint32 Crypto_Thread::readHeader(QIODevice& src, FileHeader& header, SecureVector<quint8>& key, QString& originalName)
+{
     // Read and check the header
-    quint32 magic;
-    src_stream >> magic;
+    QDataStream src_stream(&src);
+    src_stream.setVersion(QDataStream::Qt_5_0);
 
-    if (magic != 0x41525345)
-        return (NOT_AN_ARSENIC_FILE);
+    const auto read = header.read(src_stream);
+    if (read == NOT_AN_ARSENIC_FILE)
+        return (read);
 
     // Read and check the version
-    QVersionNumber version;
-    src_stream >> version;
-    emit statusMessage("this file is encrypted with Arsenic version " + version.toString());
+    emit statusMessage("this file is encrypted with Arsenic version " + header.version.toString());
 
-    if (version < m_const->APP_VERSION) {
+    if (header.version < m_const->APP_VERSION) {
         emit statusMessage("Warning: this is file is encrypted by an old Arsenic Version...");
-        emit statusMessage("Warning: version of encrypted file " + version.toString());
+        emit statusMessage("Warning: version of encrypted file " + header.version.toString());
         emit statusMessage("Warning: version of your Arsenic " + m_const->APP_VERSION.toString());
     }
 
-    if (version > m_const->APP_VERSION) {
+    if (header.version > m_const->APP_VERSION) {
         emit statusMessage("Warning: this file is encrypted with a more recent version of Arsenic...");
-        emit statusMessage("Warning: version of encrypted file " + version.toString());
+        emit statusMessage("Warning: version of encrypted file " + header.version.toString());
         emit statusMessage("Warning: version of your Arsenic " + m_const->APP_VERSION.toString());
     }
 
-    // Read Argon2 parameters
-    quint32 memlimit;
-    src_stream >> memlimit;
-
-    quint32 iterations;
-    src_stream >> iterations;
+    if (read != DECRYPT_SUCCESS)
+        return (read);
 
-    qint64 fileNameSize;
-    src_stream >> fileNameSize;
-
-    // On most systems the maximum filename length is 255 bytes
-    if (fileNameSize > 255)
+    SecureVector<quint8> master_buffer(header.nameBlockSize());
+    if (src_stream.readRawData(reinterpret_cast<char*>(master_buffer.data()), master_buffer.size()) != static_cast<int>(master_buffer.size()))
         return (SRC_HEADER_READ_ERROR);
 
-    qint64 originalfileSize;
-    src_stream >> originalfileSize;
+    // calculate the internal key with Argon2, with the parameters the file
+    // was encrypted with, and split them in three. The files of a batch share
+    // their Argon2 salt, only the first one runs it
+    if (!m_keyCache.contains(header.argonSalt, header.memlimit, header.iterations, header.parallelism))
+        emit statusMessage("Argon2 passphrase derivation... Please wait.");
 
-    SecureVector<quint8> salt_buffer(m_const->ARGON_SALT_LEN);
-    SecureVector<quint8> tripleNonce(m_const->CIPHER_IV_LEN * 3);
-    SecureVector<quint8> master_buffer(fileNameSize + m_const->IN_BUFFER_SIZE + m_const->MACBYTES * 3);
-
-    // Read the salt, the three nonces and the header
-    if (!src_stream.readRawData(reinterpret_cast<char*>(salt_buffer.data()), m_const->ARGON_SALT_LEN))
-        return (SRC_HEADER_READ_ERROR);
-
-    if (!src_stream.readRawData(reinterpret_cast<char*>(tripleNonce.data()), m_const->CIPHER_IV_LEN * 3))
-        return (SRC_HEADER_READ_ERROR);
-
-    if (!src_stream.readRawData(reinterpret_cast<char*>(master_buffer.data()), master_buffer.size()))
-        return (SRC_HEADER_READ_ERROR);
-
-    // calculate the internal key with Argon2 and split them in three
-    emit statusMessage("Argon2 passphrase derivation... Please wait.");
+    SecureVector<quint8> argonKey;
+    if (!deriveKey(argonKey, header.argonSalt, header.memlimit, header.iterations, header.parallelism))
+        return (KEY_DERIVATION_FAIL);
 
     // decrypt header
     CryptoEngine decrypt(false);
-    decrypt.setSalt(salt_buffer);
-    decrypt.derivePassword(m_password, m_argonmem, m_argoniter);
-    decrypt.setNonce(tripleNonce);
+    if (header.keyMode == m_const->KEY_MODE_MASTER)
+        decrypt.deriveFileKey(argonKey, header.fileSalt);
+    else
+        decrypt.setKey(argonKey);
+    decrypt.setNonce(header.tripleNonce);
+    key = decrypt.key();
+
+    // an archive has no name block, the names are in its index
+    if (header.archive())
+        return (DECRYPT_SUCCESS);
+
     try {
         decrypt.finish(master_buffer);
     }
@@ -297,42 +554,173 @@ quint32 Crypto_Thread::decrypt(const QString& src_path)
         return (DECRYPT_FAIL);
     }
 
-    // get from the decrypted header the three internal keys and the original filename
-    const quint8* mk2 = master_buffer.begin().base();
+    // get from the decrypted header the original filename
+    auto fileNameSize = header.fileNameSize;
+    qint64 nameOffset = 0;
+    if (header.nameBlock()) {
+        nameOffset   = m_const->NAME_LENGTH_LEN;
+        fileNameSize = master_buffer[0] << 8 | master_buffer[1];
+        if (fileNameSize > 255 || fileNameSize > static_cast<qint64>(master_buffer.size()) - nameOffset)
+            return (SRC_HEADER_READ_ERROR);
+    }
+    const quint8* mk2 = master_buffer.begin().base() + nameOffset;
     const OctetString name(mk2, fileNameSize);
 
-    // create the decrypted file
     const string tmp{(name.begin()), name.end()}; // string tmp(reinterpret_cast<const char*>(name.begin()), name.size());
-    const auto originalName = QString::fromStdString(tmp);
+    originalName = QString::fromStdString(tmp);
+    return (DECRYPT_SUCCESS);
+}
 
-    QFile des_file(Utils::uniqueFileName(absolutePath + "/" + originalName));
+quint32 Crypto_Thread::decrypt(const QString& src_path, quint32 threads)
+{
+    QFile src_file(QDir::cleanPath(src_path));
+    QFileInfo src_info(src_file);
+    QString absolutePath = src_info.absolutePath();
 
-    if (!des_file.open(QIODevice::WriteOnly))
-        return (DES_CANNOT_OPEN_WRITE);
+    if (!src_file.exists() || !src_info.isFile())
+        return (SRC_CANNOT_OPEN_READ);
 
-    QDataStream des_stream(&des_file);
-    des_stream.setVersion(QDataStream::Qt_5_0);
+    if (!src_file.open(QIODevice::ReadOnly))
+        return (SRC_CANNOT_OPEN_READ);
+
+    // open the source file and extract all informations necessary for decryption
+    FileHeader header;
+    SecureVector<quint8> key;
+    QString originalName;
+    const auto opened = readHeader(src_file, header, key, originalName);
+    if (opened != DECRYPT_SUCCESS)
+        return (opened);
+
+    if (header.archive()) {
+        const auto result = decryptArchive(src_file, key, header.tripleNonce, header.chunkSize, header.fileSize, threads);
+
+        // only a full extraction replaces the archive
+        if (result == DECRYPT_SUCCESS && m_deletefile && m_extract.isEmpty()) {
+            src_file.close();
+            src_file.remove();
+            emit deletedAfterSuccess(src_path);
+        }
+        return (result);
+    }
 
-    auto processed  = 0.;
-    auto bytes_read = 0;
-    SecureVector<quint8> inBuf(m_const->IN_BUFFER_SIZE + m_const->MACBYTES * 3);
-    while (!m_aborted && (bytes_read = src_stream.readRawData(reinterpret_cast<char*>(inBuf.data()), m_const->IN_BUFFER_SIZE + m_const->MACBYTES * 3)) > 0) {
-        // calculate percentage proccessed
-        processed += bytes_read - m_const->MACBYTES * 3;
-        emit updateProgress(src_path, (processed / originalfileSize) * 100);
-        try {
-            inBuf.resize(bytes_read);
-            decrypt.finish(inBuf);
-            des_stream.writeRawData(reinterpret_cast<char*>(inBuf.data()), inBuf.size());
-            inBuf.resize(m_const->IN_BUFFER_SIZE + m_const->MACBYTES * 3);
+    // a stream has no name, the output takes the one of the .arsn
+    if (originalName.isEmpty())
+        originalName = src_info.completeBaseName();
+
+    // the nonce of every chunk only depends on its index, so the chunks are
+    // authenticated and decrypted in parallel and written back in order
+    const auto chunkSize        = header.chunkSize;
+    const auto originalfileSize = header.fileSize;
+    ChunkPipeline pipeline(false, key, threads);
+    pipeline.setChunkSize(chunkSize);
+    pipeline.setMemoryMapped(m_memoryMapped);
+    pipeline.setDirectIo(m_directIo);
+    pipeline.setIoDepth(m_ioDepth);
+    pipeline.setFinalChunk(header.streamed());
+    pipeline.setCompression(header.compression);
+    pipeline.setAbortCallback([this] { return m_aborted.load(); });
+
+    const auto ranged = m_rangeLength >= 0;
+    auto outputSize   = originalfileSize;
+    auto des_path     = absolutePath + "/" + originalName;
+
+    if (ranged) {
+        // the data blocks have a fixed size, so only the chunks covering
+        // the range have to be read, authenticated and decrypted
+        if (m_rangeOffset < 0 || m_rangeOffset >= originalfileSize || m_rangeLength == 0)
+            return (INVALID_RANGE);
+
+        outputSize            = qMin(m_rangeLength, originalfileSize - m_rangeOffset);
+        const auto firstChunk = m_rangeOffset / chunkSize;
+        const auto lastChunk  = (m_rangeOffset + outputSize - 1) / chunkSize;
+
+        // compressed blocks have their own size, their lengths are walked
+        const auto skipped = header.compressed() ? ChunkPipeline::skipChunks(src_file, firstChunk, chunkSize)
+                                                 : src_file.seek(src_file.pos() + firstChunk * (static_cast<qint64>(chunkSize) + m_const->MACBYTES * 3));
+        if (!skipped)
+            return (SRC_HEADER_READ_ERROR);
+
+        pipeline.setChunkLimit(lastChunk - firstChunk + 1);
+        pipeline.setOutputWindow(m_rangeOffset - firstChunk * chunkSize, outputSize);
+        pipeline.setFinalChunk(false);
+        des_path += QString(".%1-%2").arg(m_rangeOffset).arg(m_rangeOffset + outputSize);
+        emit statusMessage("decryption of bytes " + QString::number(m_rangeOffset) + " to " + QString::number(m_rangeOffset + outputSize));
+    }
+
+    // a journal of an interrupted run of this file: keep the plaintext of
+    // its checkpoint and continue after it. The size of a stream is unknown,
+    // it always starts over.
+    const auto resumable = m_resumable && !ranged && !header.streamed();
+    const auto dataStart = src_file.pos();
+    Journal journal;
+    journal.path = Journal::pathFor(src_file.fileName());
+    SecureVector<quint8> state(m_const->TAG_STATE_LEN);
+    quint64 done = 0;
+    qint64 kept  = 0;
+
+    if (resumable && journal.load()) {
+        kept = qMin(static_cast<qint64>(journal.chunks) * chunkSize, originalfileSize);
+        if (!journal.direction && journal.matches(src_info) && QFileInfo(journal.output).size() >= kept &&
+            ChunkPipeline::replayTags(src_file, journal.chunks, chunkSize, header.compressed(), state) && state == journal.state) {
+            done = journal.chunks;
+            emit statusMessage("resuming " + originalName + " after " + Utils::getFileSize(kept));
         }
-        catch (const Botan::Exception&) {
+        else {
+            emit statusMessage(journal.path + " doesn't match " + src_info.fileName() + ", starting over");
+            kept = 0;
+            state.assign(m_const->TAG_STATE_LEN, 0);
+            if (!src_file.seek(dataStart))
+                return (SRC_HEADER_READ_ERROR);
+        }
+    }
+
+    // concurrent jobs may decrypt files with the same original name here
+    QFile des_file(journal.output);
+    const auto created = done > 0 ? des_file.open(QIODevice::ReadWrite)
+                                  : Utils::openUniqueFile(des_file, des_path, m_memoryMapped ? QIODevice::ReadWrite : QIODevice::WriteOnly);
+    if (!created)
+        return (DES_CANNOT_OPEN_WRITE);
+
+    if (done > 0) {
+        if (!des_file.resize(kept) || !des_file.seek(kept))
+            return (DES_CANNOT_OPEN_WRITE);
+    }
+    else if (resumable) {
+        journal.direction = false;
+        journal.output    = des_file.fileName();
+        journal.chunks    = 0;
+        journal.setSource(src_info);
+    }
+    if (resumable)
+        setCheckpoint(pipeline, des_file, journal, chunkSize, state);
+
+    if (!header.streamed()) {
+        pipeline.setProgressCallback([&](qint64 processed) {
+            emit updateProgress(src_path, (static_cast<double>(kept + processed) / outputSize) * 100);
+        });
+    }
+
+    const auto firstIndex = ranged ? m_rangeOffset / chunkSize + 1 : done + 1;
+    const auto result     = runPipeline(pipeline, src_file, des_file, header.tripleNonce, firstIndex);
+    if (result != DECRYPT_SUCCESS) {
+        des_file.close();
+
+        // a checkpoint is kept for the next run, unless the file is damaged
+        if (result == DECRYPT_FAIL || journal.chunks == 0) {
             des_file.remove();
-            return (DECRYPT_FAIL);
+            if (resumable)
+                journal.remove();
         }
-        emit updateProgress(src_path, 100);
+        return (result);
     }
 
+    // a range is an extract, the encrypted file is always kept
+    if (ranged)
+        return (DECRYPT_SUCCESS);
+
+    if (resumable)
+        journal.remove();
+
     if (m_deletefile) {
         src_file.close();
         src_file.remove();
@@ -342,7 +730,298 @@ quint32 Crypto_Thread::decrypt(const QString& src_path)
     return (DECRYPT_SUCCESS);
 }
 
+quint32 Crypto_Thread::decryptStream(QIODevice& src, QIODevice& des)
+{
+    FileHeader header;
+    SecureVector<quint8> key;
+    QString originalName;
+    const auto opened = readHeader(src, header, key, originalName);
+    if (opened != DECRYPT_SUCCESS)
+        return (opened);
+
+    // the index of an archive is at its end, out of reach of a pipe
+    if (header.archive()) {
+        emit statusMessage("An archive can't be decrypted from a stream, decrypt the file itself.");
+        return (SRC_HEADER_READ_ERROR);
+    }
+
+    const auto threads = m_threads > 0 ? m_threads : static_cast<quint32>(QThread::idealThreadCount());
+    ChunkPipeline pipeline(false, key, threads);
+    pipeline.setChunkSize(header.chunkSize);
+    pipeline.setFinalChunk(header.streamed());
+    pipeline.setCompression(header.compression);
+    pipeline.setAbortCallback([this] { return m_aborted.load(); });
+
+    return (runPipeline(pipeline, src, des, header.tripleNonce));
+}
+
+quint32 Crypto_Thread::encryptArchive(quint32 threads)
+{
+    /* format is the one of a file (see encrypt) with ARCHIVE_MAGIC_NUMBER,
+     * a fileNameSize of 0, the size of the data stream as fileSize and no
+     * encrypted name block, then:
+     * encrypted data stream  ( every member in turn, in blocks of chunkSize + MACBYTES*3 )
+     * encrypted index  ( ArchiveStream::writeIndex, the chunk after the last data block )
+     * index size  ( qint64 )
+     */
+
+    const auto archivePath = m_archive.endsWith(m_const->DEFAULT_EXTENSION) ? m_archive : m_archive + m_const->DEFAULT_EXTENSION;
+    QFile des_file(archivePath);
+    if (des_file.exists())
+        return (DES_FILE_EXISTS);
+
+    // list the members with their size, the index needs them all. The archive
+    // itself may be inside one of the trees.
+    const auto self = QFileInfo(archivePath).absoluteFilePath();
+    QList<ArchiveEntry> entries;
+    qint64 dataSize = 0;
+
+    DirectoryWalker walker;
+    walker.setFilter([&self](const QFileInfo& info) { return (info.absoluteFilePath() != self); });
+    for (const auto& root : m_filenames) {
+        ChunkQueue<QString> files(m_const->WALKER_QUEUE_SIZE);
+        walker.start(QStringList{root}, files);
+
+        QString file;
+        auto missing = false;
+        while (!missing && !m_aborted && files.pop(file)) {
+            const QFileInfo info(file);
+            missing = !info.isFile();
+            if (!missing) {
+                entries.append({ArchiveStream::entryPath(root, file), dataSize, info.size(), file});
+                dataSize += info.size();
+            }
+        }
+        files.close();
+        walker.wait();
+
+        if (missing) {
+            emit statusMessage(file + ": " + errorCodeToString(SRC_CANNOT_OPEN_READ));
+            return (SRC_CANNOT_OPEN_READ);
+        }
+    }
+    if (m_aborted)
+        return (ABORTED_BY_USER);
+    emit statusMessage(QString::number(entries.size()) + " files to archive, " + Utils::getFileSize(dataSize));
+
+    // one key for the whole archive
+    AutoSeeded_RNG rng;
+    FileHeader header;
+    header.magic       = m_const->ARCHIVE_MAGIC_NUMBER;
+    header.memlimit    = m_argonmem;
+    header.iterations  = m_argoniter;
+    header.chunkSize   = m_chunkSize > 0 ? m_chunkSize : ChunkPipeline::adaptiveChunkSize(dataSize);
+    header.parallelism = m_parallelism;
+    header.fileSize    = dataSize;
+    header.argonSalt   = rng.random_vec(m_const->ARGON_SALT_LEN);
+    header.tripleNonce = rng.random_vec(m_const->CIPHER_IV_LEN * 3);
+
+    const auto chunkSize   = header.chunkSize;
+    const auto tripleNonce = header.tripleNonce;
+
+    emit statusMessage("Argon2 passphrase derivation... Please wait.");
+    SecureVector<quint8> argonKey;
+    if (!deriveKey(argonKey, header.argonSalt, m_argonmem, m_argoniter, m_parallelism, false))
+        return (KEY_DERIVATION_FAIL);
+    CryptoEngine encrypt(true);
+    encrypt.setKey(argonKey);
+    encrypt.setNonce(tripleNonce);
+
+    if (!des_file.open(m_memoryMapped ? QIODevice::ReadWrite : QIODevice::WriteOnly))
+        return (DES_CANNOT_OPEN_WRITE);
+
+    QDataStream des_stream(&des_file);
+    des_stream.setVersion(QDataStream::Qt_5_0);
+    header.write(des_stream);
+
+    // the members are one stream for the pipeline, so small files are packed
+    // in shared chunks
+    ArchiveStream src_stream(entries);
+    src_stream.open(QIODevice::ReadOnly);
+
+    ChunkPipeline pipeline(true, encrypt.key(), threads);
+    pipeline.setChunkSize(chunkSize);
+    pipeline.setDirectIo(m_directIo);
+    pipeline.setIoDepth(m_ioDepth);
+    pipeline.setProgressCallback([&](qint64 processed) {
+        emit updateProgress(archivePath, (static_cast<double>(processed) / dataSize) * 100);
+    });
+    pipeline.setAbortCallback([this] { return m_aborted.load(); });
+
+    auto result = runPipeline(pipeline, src_stream, des_file, tripleNonce);
+    if (result == CRYPT_SUCCESS && src_stream.truncated()) {
+        emit statusMessage(src_stream.errorString());
+        result = SRC_CANNOT_OPEN_READ;
+    }
+    if (result == CRYPT_SUCCESS && m_aborted)
+        result = ABORTED_BY_USER;
+
+    if (result == CRYPT_SUCCESS) {
+        // the index takes the chunk index after the last data block
+        const auto chunks    = (dataSize + chunkSize - 1) / chunkSize;
+        const auto indexData = ArchiveStream::writeIndex(entries);
+        SecureVector<quint8> index(indexData.begin(), indexData.end());
+        encrypt.setChunkIndex(chunks + 1);
+        encrypt.finish(index);
+
+        des_stream.writeRawData(reinterpret_cast<char*>(index.data()), index.size());
+        des_stream << static_cast<qint64>(index.size());
+        if (des_stream.status() != QDataStream::Ok)
+            result = DES_CANNOT_OPEN_WRITE;
+    }
+
+    if (result != CRYPT_SUCCESS) {
+        des_file.close();
+        des_file.remove();
+        return (result);
+    }
+
+    if (m_deletefile) {
+        for (const auto& entry : entries) {
+            QFile::remove(entry.file);
+            emit deletedAfterSuccess(entry.file);
+        }
+    }
+    emit addEncrypted(des_file.fileName());
+    return (CRYPT_SUCCESS);
+}
+
+quint32 Crypto_Thread::decryptArchive(QFile& src_file,
+                                      const SecureVector<quint8>& key,
+                                      const SecureVector<quint8>& nonce,
+                                      quint32 chunkSize,
+                                      qint64 dataSize,
+                                      quint32 threads)
+{
+    const qint64 tags      = m_const->MACBYTES * 3;
+    const auto dataStart   = src_file.pos();
+    const qint64 chunks    = (dataSize + chunkSize - 1) / chunkSize;
+    const auto dataEnd     = dataStart + dataSize + chunks * tags;
+    const auto trailerSize = static_cast<qint64>(sizeof(qint64));
+
+    // the index lies between the data and its size, the last 8 bytes
+    QDataStream src_stream(&src_file);
+    src_stream.setVersion(QDataStream::Qt_5_0);
+
+    qint64 indexSize = 0;
+    if (!src_file.seek(src_file.size() - trailerSize))
+        return (SRC_HEADER_READ_ERROR);
+    src_stream >> indexSize;
+
+    if (indexSize < tags || dataEnd + indexSize + trailerSize != src_file.size())
+        return (SRC_HEADER_READ_ERROR);
+
+    SecureVector<quint8> index(indexSize);
+    if (!src_file.seek(dataEnd) || src_stream.readRawData(reinterpret_cast<char*>(index.data()), indexSize) != indexSize)
+        return (SRC_HEADER_READ_ERROR);
+
+    CryptoEngine decrypt(false);
+    decrypt.setKey(key);
+    decrypt.setNonce(nonce);
+    decrypt.setChunkIndex(chunks + 1);
+    try {
+        decrypt.finish(index);
+    }
+    catch (const Botan::Exception&) {
+        return (DECRYPT_FAIL);
+    }
+
+    QList<ArchiveEntry> entries;
+    if (!ArchiveStream::readIndex(QByteArray(reinterpret_cast<const char*>(index.data()), index.size()), dataSize, entries))
+        return (SRC_HEADER_READ_ERROR);
+
+    // every member, or the file or folder asked for, next to the archive
+    const auto folder = QFileInfo(src_file).absolutePath();
+    QList<ArchiveEntry> selected;
+    for (auto& entry : entries) {
+        if (m_extract.isEmpty() || entry.path == m_extract || entry.path.startsWith(m_extract + "/")) {
+            entry.file = folder + "/" + entry.path;
+            selected.append(entry);
+        }
+    }
+    if (selected.isEmpty())
+        return (ARCHIVE_MEMBER_NOT_FOUND);
+
+    ArchiveStream des_stream(selected);
+    if (!des_stream.open(QIODevice::WriteOnly)) {
+        des_stream.removeCreated();
+        return (DES_CANNOT_OPEN_WRITE);
+    }
+
+    // as for a range, only the chunks covering the selected members are read,
+    // authenticated and decrypted
+    quint32 result   = DECRYPT_SUCCESS;
+    const auto first = selected.first().offset;
+    const auto last  = selected.last().offset + selected.last().size;
+    if (last > first) {
+        const auto firstChunk = first / chunkSize;
+        const auto lastChunk  = (last - 1) / chunkSize;
+        if (!src_file.seek(dataStart + firstChunk * (chunkSize + tags))) {
+            des_stream.removeCreated();
+            return (SRC_HEADER_READ_ERROR);
+        }
+
+        ChunkPipeline pipeline(false, key, threads);
+        pipeline.setChunkSize(chunkSize);
+        pipeline.setChunkLimit(lastChunk - firstChunk + 1);
+        // the last block is short, the encrypted index follows it
+        pipeline.setInputLimit(dataEnd);
+        pipeline.setDirectIo(m_directIo);
+        pipeline.setIoDepth(m_ioDepth);
+        pipeline.setOutputWindow(first - firstChunk * chunkSize, last - first);
+        pipeline.setAbortCallback([this] { return m_aborted.load(); });
+        pipeline.setProgressCallback([&](qint64 processed) {
+            emit updateProgress(src_file.fileName(), (static_cast<double>(processed) / (last - first)) * 100);
+        });
+
+        result = runPipeline(pipeline, src_file, des_stream, nonce, firstChunk + 1);
+    }
+
+    des_stream.close();
+    if (result != DECRYPT_SUCCESS) {
+        des_stream.removeCreated();
+        return (result);
+    }
+
+    emit statusMessage(QString::number(selected.size()) + " files extracted from " + QFileInfo(src_file).fileName());
+    return (DECRYPT_SUCCESS);
+}
+
 void Crypto_Thread::abort()
 {
     m_aborted = true;
 }
+
+quint64 Crypto_Thread::poolBuffers() const
+{
+    return (m_poolBuffers);
+}
+
+bool Crypto_Thread::mapped() const
+{
+    return (m_mapped);
+}
+
+quint64 Crypto_Thread::peakMemory() const
+{
+    return (m_peakMemory);
+}
+
+quint32 Crypto_Thread::runPipeline(ChunkPipeline& pipeline, QIODevice& src, QIODevice& des, const SecureVector<quint8>& nonce, quint64 firstIndex)
+{
+    // the pipelines running at once share the budget by their chunk workers
+    const auto threads = m_budgetThreads > 0 ? qMin(pipeline.threads(), m_budgetThreads) : 0;
+    pipeline.setMemoryBudget(m_budgetThreads > 0 ? m_memoryBudget * threads / m_budgetThreads : m_memoryBudget);
+
+    const auto memory = pipeline.memoryUsage();
+    const auto inUse  = m_memoryInUse += memory;
+    auto peak         = m_peakMemory.load();
+    while (inUse > peak && !m_peakMemory.compare_exchange_weak(peak, inUse)) {
+    }
+
+    const auto result = pipeline.run(src, des, nonce, firstIndex);
+    m_memoryInUse -= memory;
+    m_poolBuffers = pipeline.poolBuffers();
+    m_mapped      = pipeline.mapped();
+    return (result);
+}
@@ -1,9 +1,14 @@
 #pragma once
 
+#include <QFile>
 #include <QObject>
 #include <QThread>
+#include <atomic>
 
+#include "botan_all.h"
 #include "consts.h"
+#include "fileheader.h"
+#include "keycache.h"
 #include "libexport.h"
 
 #ifdef CRYPTOTHREAD_EXPORT
@@ -12,6 +17,9 @@
 #define CRYPTOTHREAD_API Q_DECL_IMPORT
 #endif
 
+class ChunkPipeline;
+struct Journal;
+
 class LIB_EXPORT Crypto_Thread : public QThread {
     Q_OBJECT
 
@@ -26,8 +34,109 @@ class LIB_EXPORT Crypto_Thread : public QThread {
                   quint32 const argoniter,
                   bool const deletefile);
 
+    // number of crypto workers used for the data chunks of a large file,
+    // 0 means one per core
+    void setThreads(quint32 threads);
+
+    // number of small files processed at once, 0 means one per core.
+    // See JobScheduler.
+    void setConcurrency(quint32 files);
+
+    // KiB of memory the Argon2 runs of the job may use at once,
+    // ARGON_MEMORY_BUDGET by default
+    void setArgonMemoryBudget(quint64 memory);
+
+    // only decrypt length bytes of plaintext starting at offset. The output is
+    // written next to the source as "<original name>.<offset>-<end>". Call it
+    // after setParam(), which resets the range.
+    void setRange(qint64 offset, qint64 length);
+
+    // pack every source (files and directory trees) in this one encrypted
+    // archive instead of one .arsn per file. Call it after setParam(), which
+    // resets it. See ArchiveStream.
+    void setArchive(const QString &archive);
+
+    // only extract this member (a file or a folder) of the archives being
+    // decrypted, everything by default. Call it after setParam().
+    void setExtract(const QString &member);
+
+    // plaintext size of the data blocks of new files, between MIN_CHUNK_SIZE
+    // and MAX_CHUNK_SIZE. 0 (default) picks it from the file size, see
+    // ChunkPipeline::adaptiveChunkSize.
+    void setChunkSize(quint32 chunkSize);
+
+    // the encrypted name block of new files is padded to a multiple of this
+    // many bytes, NAME_PADDING by default. 0 disables the padding and lets
+    // the header show the length of the name.
+    void setNamePadding(quint32 bucket);
+
+    // COMPRESSION_ZLIB compresses the data blocks of new files before their
+    // encryption, COMPRESSION_NONE (default) keeps the fixed block layout.
+    // Archives are never compressed, see ArchiveStream.
+    void setCompression(quint32 codec);
+
+    // keep a Journal next to the .arsn of every file and checkpoint the job
+    // in it, so an interrupted or killed run continues from the last
+    // checkpoint when it is started again. Archives, streams and ranges
+    // always start over.
+    void setResumable(bool resumable);
+
+    // Argon2 lanes of new files, derived in parallel when above 1.
+    // PARALLELISM_DEFAULT by default, stored in the header.
+    void setParallelism(quint32 lanes);
+
+    // Argon2 parameters of new files other than the presets of setParam(),
+    // e.g. the result of ArgonCalibration. memlimit is in KiB. False, and
+    // nothing changes, outside of the bounds FileHeader::read accepts. Call it
+    // after setParam(), whose presets replace memlimit and iterations.
+    bool setArgonParameters(quint32 memlimit, quint32 iterations, quint32 lanes);
+
+    // Derive one master key per job with Argon2, and the key of every file
+    // from it with HKDF and a per-file salt (KEY_MODE_MASTER). Only used for
+    // encryption, decryption follows the header of each file.
+    void setBatchMode(bool batch);
+
+    // Argon2 runs of the last job, see KeyCache::derivations
+    quint64 derivations() const;
+    // wipe the keys kept for the next jobs. Decryption always uses the Argon2
+    // parameters of the file, so a key is reused for any file with the same
+    // salt and parameters, as long as the password doesn't change.
+    void clearKeys();
+
+    // use memory mapped I/O for regular files instead of read/write calls
+    void setMemoryMapped(bool mapped);
+    // read and write the data blocks of regular files around the page cache,
+    // for bulk jobs that must not evict the cache of other programs. See
+    // ChunkPipeline::setDirectIo, resumable jobs keep the cache.
+    void setDirectIo(bool direct);
+    // reads and writes of the data blocks kept in flight with io_uring (or
+    // blocking threads), 0 (default) for one blocking call at a time. See
+    // ChunkPipeline::setIoDepth.
+    void setIoDepth(quint32 depth);
+
     void abort();
 
+    // encrypt src to des in the calling thread, without a file name and with
+    // STREAM_FILE_SIZE as size: both may be pipes. The chunks use m_threads
+    // workers, batch mode and progress are ignored.
+    quint32 encryptStream(QIODevice &src, QIODevice &des);
+    // decrypt a file written by encryptStream (or a regular .arsn) from src
+    // to des in the calling thread. A stream cut after a full chunk fails.
+    quint32 decryptStream(QIODevice &src, QIODevice &des);
+
+    // pool buffers allocated for the last file, see ChunkPipeline::poolBuffers
+    quint64 poolBuffers() const;
+    // the last file went through memory mappings, see setMemoryMapped
+    bool mapped() const;
+
+    // bytes of chunk buffers the files of a job hold together at most,
+    // PIPELINE_MEMORY_BUDGET by default. The files processed at once share
+    // it by their chunk workers, see ChunkPipeline::setMemoryBudget.
+    void setMemoryBudget(quint64 memory);
+    // bytes of chunk buffers held at once during the last job, reported in
+    // a status message at its end
+    quint64 peakMemory() const;
+
   signals:
     void updateProgress(const QString &path, quint32 percent);
     void statusMessage(const QString &message);
@@ -35,15 +144,74 @@ class LIB_EXPORT Crypto_Thread : public QThread {
     void deletedAfterSuccess(const QString &inputFileName);
 
   private:
-    quint32 encrypt(const QString &src_path);
-    quint32 decrypt(const QString &src_path);
+    quint32 encrypt(const QString &src_path, quint32 threads);
+    quint32 decrypt(const QString &src_path, quint32 threads);
+    quint32 encryptDevice(QIODevice &src,
+                          QIODevice &des,
+                          const QString &name,
+                          qint64 fileSize,
+                          bool batch,
+                          quint32 threads,
+                          const QString &progressPath,
+                          Journal *journal);
+    // the Argon2 key from m_keyCache, false if it can't be derived: the
+    // parameters of a header may ask for more memory than there is
+    bool deriveKey(Botan::SecureVector<quint8> &key,
+                   const Botan::SecureVector<quint8> &salt,
+                   quint32 memlimit,
+                   quint32 iterations,
+                   quint32 parallelism,
+                   bool keep = true);
+    // write the header and the name block of a new file to des,
+    // KEY_DERIVATION_FAIL if the key can't be derived
+    quint32 encryptHeader(QIODevice &des, FileHeader &header, Botan::SecureVector<quint8> &key, const QString &name, qint64 fileSize, bool batch);
+    // sync des and save journal every JOURNAL_INTERVAL bytes of the run
+    void setCheckpoint(ChunkPipeline &pipeline, QIODevice &des, Journal &journal, quint32 chunkSize, const Botan::SecureVector<quint8> &state);
+    // pipeline.run() within the memory budget, accounted in peakMemory()
+    quint32 runPipeline(ChunkPipeline &pipeline, QIODevice &src, QIODevice &des, const Botan::SecureVector<quint8> &nonce, quint64 firstIndex = 1);
+    // read the header and the name block from src and derive the key
+    quint32 readHeader(QIODevice &src, FileHeader &header, Botan::SecureVector<quint8> &key, QString &originalName);
+    quint32 encryptArchive(quint32 threads);
+    quint32 decryptArchive(QFile &src_file,
+                           const Botan::SecureVector<quint8> &key,
+                           const Botan::SecureVector<quint8> &nonce,
+                           quint32 chunkSize,
+                           qint64 dataSize,
+                           quint32 threads);
     QStringList m_filenames;
     QString m_password;
+    QString m_archive;
+    QString m_extract;
     quint32 m_argonmem;
     quint32 m_argoniter;
     bool m_direction;
     bool m_deletefile;
-    bool m_aborted = false;
+    quint32 m_threads     = 0;
+    quint32 m_concurrency = 0;
+    quint64 m_argonBudget = consts::ARGON_MEMORY_BUDGET;
+    quint32 m_chunkSize   = 0;
+    quint32 m_namePadding = consts::NAME_PADDING;
+    quint32 m_compression = consts::COMPRESSION_NONE;
+    quint32 m_parallelism = consts::PARALLELISM_DEFAULT;
+    qint64 m_rangeOffset  = 0;
+    qint64 m_rangeLength  = -1;
+    bool m_memoryMapped   = false;
+    bool m_directIo       = false;
+    quint32 m_ioDepth     = 0;
+    bool m_batchMode      = false;
+    bool m_resumable      = false;
+    std::atomic<bool> m_aborted{false};
+    std::atomic<quint64> m_poolBuffers{0};
+    std::atomic<bool> m_mapped{false};
+    quint64 m_memoryBudget  = consts::PIPELINE_MEMORY_BUDGET;
+    quint32 m_budgetThreads = 0; // chunk workers of the running job, 0 outside run()
+    std::atomic<quint64> m_memoryInUse{0};
+    std::atomic<quint64> m_peakMemory{0};
+    quint64 m_derivations = 0;
+
+    // Argon2 outputs of the last jobs, and the salt of the running job's master key
+    KeyCache m_keyCache;
+    Botan::SecureVector<quint8> m_batchSalt;
 
     const std::unique_ptr<consts> m_const;
 };
@@ -0,0 +1,193 @@
+#include "archivestream.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFileInfo>
+
+#include "utils.h"
+
+namespace {
+// a stored path must stay inside the folder the archive is extracted to
+bool safePath(const QString &path)
+{
+    return (!path.isEmpty() && path != "." && path != ".." && !path.startsWith("../") &&
+            QDir::isRelativePath(path) && QDir::cleanPath(path) == path);
+}
+} // namespace
+
+ArchiveStream::ArchiveStream(const QList<ArchiveEntry> &entries)
+    : m_entries(entries)
+{
+}
+
+ArchiveStream::~ArchiveStream()
+{
+    close();
+}
+
+bool ArchiveStream::open(OpenMode mode)
+{
+    m_current   = 0;
+    m_position  = m_entries.isEmpty() ? 0 : m_entries.first().offset;
+    m_truncated = false;
+
+    // no data will ever reach the empty members
+    if (mode & QIODevice::WriteOnly) {
+        for (auto &entry : m_entries) {
+            if (entry.size > 0)
+                continue;
+            QDir().mkpath(QFileInfo(entry.file).absolutePath());
+            QFile file;
+            if (!Utils::openUniqueFile(file, entry.file, QIODevice::WriteOnly))
+                return (false);
+            m_created.append(file.fileName());
+        }
+    }
+    return (QIODevice::open(mode | QIODevice::Unbuffered));
+}
+
+void ArchiveStream::close()
+{
+    m_file.close();
+    QIODevice::close();
+}
+
+bool ArchiveStream::isSequential() const
+{
+    return (true);
+}
+
+bool ArchiveStream::truncated() const
+{
+    return (m_truncated);
+}
+
+void ArchiveStream::removeCreated()
+{
+    m_file.close();
+    for (const auto &file : m_created)
+        QFile::remove(file);
+    m_created.clear();
+}
+
+qint64 ArchiveStream::readData(char *data, qint64 maxSize)
+{
+    qint64 done = 0;
+    while (done < maxSize && m_current < m_entries.size()) {
+        const auto &entry = m_entries.at(m_current);
+        const auto left   = entry.offset + entry.size - m_position;
+        if (left <= 0) {
+            m_file.close();
+            ++m_current;
+            continue;
+        }
+
+        // a member that disappeared or shrank since the walk: the sizes of
+        // the index would be wrong, give up
+        const auto bytes = m_file.isOpen() || openEntry() ? m_file.read(data + done, qMin(left, maxSize - done)) : -1;
+        if (bytes <= 0) {
+            m_truncated = true;
+            setErrorString(entry.file + ": " + m_file.errorString());
+            return (-1);
+        }
+        done += bytes;
+        m_position += bytes;
+    }
+    return (done);
+}
+
+qint64 ArchiveStream::writeData(const char *data, qint64 size)
+{
+    qint64 done = 0;
+    while (done < size && m_current < m_entries.size()) {
+        const auto &entry = m_entries.at(m_current);
+        const auto end    = entry.offset + entry.size;
+        if (m_position >= end) {
+            m_file.close();
+            ++m_current;
+            continue;
+        }
+
+        // data of a member that was not selected
+        if (m_position < entry.offset) {
+            const auto skip = qMin(entry.offset - m_position, size - done);
+            done += skip;
+            m_position += skip;
+            continue;
+        }
+
+        if (!m_file.isOpen() && !openEntry())
+            return (-1);
+
+        const auto bytes = m_file.write(data + done, qMin(end - m_position, size - done));
+        if (bytes <= 0)
+            return (-1);
+        done += bytes;
+        m_position += bytes;
+    }
+
+    // past the last selected member
+    return (size);
+}
+
+bool ArchiveStream::openEntry()
+{
+    const auto &entry = m_entries.at(m_current);
+    if (openMode() & QIODevice::ReadOnly) {
+        m_file.setFileName(entry.file);
+        return (m_file.open(QIODevice::ReadOnly));
+    }
+
+    // never overwrite a file already there, as for a single file
+    QDir().mkpath(QFileInfo(entry.file).absolutePath());
+    if (!Utils::openUniqueFile(m_file, entry.file, QIODevice::WriteOnly))
+        return (false);
+    m_created.append(m_file.fileName());
+    return (true);
+}
+
+QByteArray ArchiveStream::writeIndex(const QList<ArchiveEntry> &entries)
+{
+    QByteArray index;
+    QDataStream stream(&index, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    stream << static_cast<quint32>(entries.size());
+    for (const auto &entry : entries)
+        stream << entry.path << static_cast<qint64>(entry.offset) << static_cast<qint64>(entry.size);
+    return (index);
+}
+
+bool ArchiveStream::readIndex(const QByteArray &index, qint64 dataSize, QList<ArchiveEntry> &entries)
+{
+    QDataStream stream(index);
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    quint32 count;
+    stream >> count;
+    // an entry takes more than 16 bytes, don't trust a count the index can't hold
+    if (stream.status() != QDataStream::Ok || count > static_cast<quint32>(index.size() / 16))
+        return (false);
+
+    entries.clear();
+    qint64 offset = 0;
+    for (quint32 i = 0; i < count; ++i) {
+        ArchiveEntry entry;
+        stream >> entry.path >> entry.offset >> entry.size;
+
+        if (stream.status() != QDataStream::Ok || !safePath(entry.path))
+            return (false);
+        if (entry.offset != offset || entry.size < 0 || entry.size > dataSize - offset)
+            return (false);
+
+        offset += entry.size;
+        entries.append(entry);
+    }
+    return (offset == dataSize && stream.atEnd());
+}
+
+QString ArchiveStream::entryPath(const QString &root, const QString &file)
+{
+    const QDir parent(QFileInfo(QDir::cleanPath(root)).absolutePath());
+    return (parent.relativeFilePath(QFileInfo(file).absoluteFilePath()));
+}
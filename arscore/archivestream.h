@@ -0,0 +1,68 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QIODevice>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+#include "libexport.h"
+
+struct ArchiveEntry {
+    QString path;      // relative path in the archive, '/' separated
+    qint64 offset = 0; // in the plaintext data stream of the archive
+    qint64 size   = 0;
+    QString file;      // on disk, not stored in the index
+};
+
+/* The plaintext data stream of an .arsn archive: the members one after the
+ * other, with nothing in between. The ChunkPipeline encrypts and decrypts it
+ * like the content of a single file, and the index gives the offset and size
+ * of every member, so one member can be decrypted alone.
+ *
+ * Opened ReadOnly, the stream reads the files of the entries in turn.
+ * Opened WriteOnly, it starts at the offset of the first entry and splits the
+ * data back into the files of the entries. Bytes between the entries (the
+ * members that were not selected) are dropped. Files are created with their
+ * directories as the data arrives, empty members when the stream is opened.
+ */
+class LIB_EXPORT ArchiveStream : public QIODevice {
+  public:
+    // entries sorted by offset
+    explicit ArchiveStream(const QList<ArchiveEntry> &entries);
+    ~ArchiveStream() override;
+
+    bool open(OpenMode mode) override;
+    void close() override;
+    bool isSequential() const override;
+
+    // true if a member was shorter on disk than in the index
+    bool truncated() const;
+    // delete the files created so far, after a failed extraction
+    void removeCreated();
+
+    // serialized entries (path, offset, size), encrypted as the last chunk
+    static QByteArray writeIndex(const QList<ArchiveEntry> &entries);
+    // false if the index is malformed, the members don't follow each other
+    // from offset 0 to dataSize, or a path would leave the extraction folder
+    static bool readIndex(const QByteArray &index, qint64 dataSize, QList<ArchiveEntry> &entries);
+
+    // the path stored for file, found under root (a file or a directory
+    // given on the command line): relative to the folder holding root
+    static QString entryPath(const QString &root, const QString &file);
+
+  protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 size) override;
+
+  private:
+    bool openEntry();
+
+    QList<ArchiveEntry> m_entries;
+    int m_current     = 0;
+    qint64 m_position = 0; // in the data stream of the archive
+    bool m_truncated  = false;
+    QFile m_file;
+    QStringList m_created;
+};
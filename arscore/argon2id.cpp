@@ -0,0 +1,363 @@
+#include "argon2id.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "botan_all.h"
+
+using namespace Botan;
+using namespace std;
+
+namespace {
+
+const quint32 BLOCK_WORDS  = 128; // 1024 bytes
+const quint32 SYNC_POINTS  = 4;
+const quint32 ARGON_TYPE   = 2; // Argon2id
+const quint32 VERSION_CODE = 0x13;
+
+struct Block {
+    quint64 v[BLOCK_WORDS];
+};
+
+void storeLE32(quint8 *out, quint32 value)
+{
+    for (auto i = 0; i < 4; ++i)
+        out[i] = static_cast<quint8>(value >> (8 * i));
+}
+
+quint64 loadLE64(const quint8 *in)
+{
+    quint64 value = 0;
+    for (auto i = 7; i >= 0; --i)
+        value = (value << 8) | in[i];
+    return (value);
+}
+
+void storeLE64(quint8 *out, quint64 value)
+{
+    for (auto i = 0; i < 8; ++i)
+        out[i] = static_cast<quint8>(value >> (8 * i));
+}
+
+unique_ptr<HashFunction> blake2b(size_t outputLength)
+{
+    return (HashFunction::create_or_throw("BLAKE2b(" + to_string(outputLength * 8) + ")"));
+}
+
+// H' of the RFC: BLAKE2b extended to any output length
+void blake2bLong(quint8 *output, size_t outputLength, const quint8 *input, size_t inputLength)
+{
+    quint8 length[4];
+    storeLE32(length, static_cast<quint32>(outputLength));
+
+    if (outputLength <= 64) {
+        auto hash = blake2b(outputLength);
+        hash->update(length, sizeof(length));
+        hash->update(input, inputLength);
+        hash->final(output);
+        return;
+    }
+
+    // chain 64 byte hashes, keeping the first half of each
+    auto hash = blake2b(64);
+    quint8 v[64];
+    hash->update(length, sizeof(length));
+    hash->update(input, inputLength);
+    hash->final(v);
+    memcpy(output, v, 32);
+    output += 32;
+    outputLength -= 32;
+
+    while (outputLength > 64) {
+        hash->update(v, sizeof(v));
+        hash->final(v);
+        memcpy(output, v, 32);
+        output += 32;
+        outputLength -= 32;
+    }
+
+    auto last = blake2b(outputLength);
+    last->update(v, sizeof(v));
+    last->final(output);
+    secure_scrub_memory(v, sizeof(v));
+}
+
+inline quint64 rotr(quint64 x, int n)
+{
+    return ((x >> n) | (x << (64 - n)));
+}
+
+inline quint64 blamka(quint64 x, quint64 y)
+{
+    return (x + y + 2 * (x & 0xFFFFFFFF) * (y & 0xFFFFFFFF));
+}
+
+inline void gb(quint64 &a, quint64 &b, quint64 &c, quint64 &d)
+{
+    a = blamka(a, b);
+    d = rotr(d ^ a, 32);
+    c = blamka(c, d);
+    b = rotr(b ^ c, 24);
+    a = blamka(a, b);
+    d = rotr(d ^ a, 16);
+    c = blamka(c, d);
+    b = rotr(b ^ c, 63);
+}
+
+// the permutation P on 16 words, given by their indexes in the block
+inline void permute(quint64 *v, const quint32 (&i)[16])
+{
+    gb(v[i[0]], v[i[4]], v[i[8]], v[i[12]]);
+    gb(v[i[1]], v[i[5]], v[i[9]], v[i[13]]);
+    gb(v[i[2]], v[i[6]], v[i[10]], v[i[14]]);
+    gb(v[i[3]], v[i[7]], v[i[11]], v[i[15]]);
+    gb(v[i[0]], v[i[5]], v[i[10]], v[i[15]]);
+    gb(v[i[1]], v[i[6]], v[i[11]], v[i[12]]);
+    gb(v[i[2]], v[i[7]], v[i[8]], v[i[13]]);
+    gb(v[i[3]], v[i[4]], v[i[9]], v[i[14]]);
+}
+
+// next = G(prev, ref), XORed into next from the second pass on
+void fillBlock(const Block &prev, const Block &ref, Block &next, bool withXor)
+{
+    Block r;
+    Block tmp;
+    for (quint32 i = 0; i < BLOCK_WORDS; ++i) {
+        r.v[i]   = prev.v[i] ^ ref.v[i];
+        tmp.v[i] = withXor ? r.v[i] ^ next.v[i] : r.v[i];
+    }
+
+    for (quint32 row = 0; row < 8; ++row) {
+        const auto b              = 16 * row;
+        const quint32 indexes[16] = {b, b + 1, b + 2, b + 3, b + 4, b + 5, b + 6, b + 7,
+                                     b + 8, b + 9, b + 10, b + 11, b + 12, b + 13, b + 14, b + 15};
+        permute(r.v, indexes);
+    }
+    for (quint32 col = 0; col < 8; ++col) {
+        const auto b              = 2 * col;
+        const quint32 indexes[16] = {b, b + 1, b + 16, b + 17, b + 32, b + 33, b + 48, b + 49,
+                                     b + 64, b + 65, b + 80, b + 81, b + 96, b + 97, b + 112, b + 113};
+        permute(r.v, indexes);
+    }
+
+    for (quint32 i = 0; i < BLOCK_WORDS; ++i)
+        next.v[i] = tmp.v[i] ^ r.v[i];
+}
+
+class Instance {
+  public:
+    Instance(quint32 memoryBlocks, quint32 iterations, quint32 lanes)
+        : m_iterations(iterations),
+          m_lanes(lanes),
+          m_laneLength(memoryBlocks / lanes),
+          m_segmentLength(m_laneLength / SYNC_POINTS),
+          m_memory(static_cast<size_t>(m_laneLength) * lanes)
+    {
+    }
+
+    ~Instance()
+    {
+        secure_scrub_memory(m_memory.data(), m_memory.size() * sizeof(Block));
+    }
+
+    Block &block(quint32 lane, quint32 index)
+    {
+        return (m_memory[static_cast<size_t>(lane) * m_laneLength + index]);
+    }
+
+    quint32 laneLength() const
+    {
+        return (m_laneLength);
+    }
+
+    quint32 memoryBlocks() const
+    {
+        return (m_laneLength * m_lanes);
+    }
+
+    void fillSegment(quint32 pass, quint32 slice, quint32 lane);
+
+  private:
+    quint32 referenceIndex(quint32 pass, quint32 slice, quint32 index, quint32 pseudoRand, bool sameLane) const;
+
+    quint32 m_iterations;
+    quint32 m_lanes;
+    quint32 m_laneLength;
+    quint32 m_segmentLength;
+    vector<Block> m_memory;
+};
+
+quint32 Instance::referenceIndex(quint32 pass, quint32 slice, quint32 index, quint32 pseudoRand, bool sameLane) const
+{
+    // blocks of the lane that may be referenced from this position
+    quint32 areaSize;
+    if (pass == 0) {
+        if (slice == 0)
+            areaSize = index - 1;
+        else if (sameLane)
+            areaSize = slice * m_segmentLength + index - 1;
+        else
+            areaSize = slice * m_segmentLength - (index == 0 ? 1 : 0);
+    }
+    else {
+        if (sameLane)
+            areaSize = m_laneLength - m_segmentLength + index - 1;
+        else
+            areaSize = m_laneLength - m_segmentLength - (index == 0 ? 1 : 0);
+    }
+
+    quint64 relative = pseudoRand;
+    relative         = (relative * relative) >> 32;
+    relative         = areaSize - 1 - ((areaSize * relative) >> 32);
+
+    const quint32 start = pass == 0 || slice == SYNC_POINTS - 1 ? 0 : (slice + 1) * m_segmentLength;
+    return (static_cast<quint32>((start + relative) % m_laneLength));
+}
+
+void Instance::fillSegment(quint32 pass, quint32 slice, quint32 lane)
+{
+    // Argon2id is data-independent for the first half of the first pass
+    const auto independent = pass == 0 && slice < SYNC_POINTS / 2;
+
+    Block zero{};
+    Block input{};
+    Block addresses{};
+    if (independent) {
+        input.v[0] = pass;
+        input.v[1] = lane;
+        input.v[2] = slice;
+        input.v[3] = memoryBlocks();
+        input.v[4] = m_iterations;
+        input.v[5] = ARGON_TYPE;
+    }
+
+    const auto nextAddresses = [&] {
+        ++input.v[6];
+        fillBlock(zero, input, addresses, false);
+        fillBlock(zero, addresses, addresses, false);
+    };
+
+    // the first two blocks of every lane come from H0
+    quint32 first = 0;
+    if (pass == 0 && slice == 0) {
+        first = 2;
+        if (independent)
+            nextAddresses();
+    }
+
+    for (auto index = first; index < m_segmentLength; ++index) {
+        const auto current  = slice * m_segmentLength + index;
+        const auto previous = current == 0 ? m_laneLength - 1 : current - 1;
+
+        quint64 pseudoRand;
+        if (independent) {
+            if (index % BLOCK_WORDS == 0)
+                nextAddresses();
+            pseudoRand = addresses.v[index % BLOCK_WORDS];
+        }
+        else {
+            pseudoRand = block(lane, previous).v[0];
+        }
+
+        auto refLane = static_cast<quint32>((pseudoRand >> 32) % m_lanes);
+        if (pass == 0 && slice == 0)
+            refLane = lane;
+
+        const auto refIndex = referenceIndex(pass, slice, index, static_cast<quint32>(pseudoRand), refLane == lane);
+        fillBlock(block(lane, previous), block(refLane, refIndex), block(lane, current), pass > 0);
+    }
+}
+
+} // namespace
+
+void Argon2id::derive(quint8 *output,
+                      size_t outputLength,
+                      const char *password,
+                      size_t passwordLength,
+                      const quint8 *salt,
+                      size_t saltLength,
+                      quint32 memlimit,
+                      quint32 iterations,
+                      quint32 lanes,
+                      quint32 threads)
+{
+    if (lanes == 0 || iterations == 0 || outputLength < 4 || memlimit < 8 * lanes)
+        throw std::invalid_argument("Invalid Argon2id parameters");
+
+    // H0, no secret key and no associated data
+    quint8 h0[64 + 8];
+    {
+        auto hash = blake2b(64);
+        quint8 word[4];
+        const quint32 params[] = {lanes, static_cast<quint32>(outputLength), memlimit, iterations, VERSION_CODE, ARGON_TYPE};
+        for (const auto param : params) {
+            storeLE32(word, param);
+            hash->update(word, sizeof(word));
+        }
+        storeLE32(word, static_cast<quint32>(passwordLength));
+        hash->update(word, sizeof(word));
+        hash->update(reinterpret_cast<const quint8 *>(password), passwordLength);
+        storeLE32(word, static_cast<quint32>(saltLength));
+        hash->update(word, sizeof(word));
+        hash->update(salt, saltLength);
+        storeLE32(word, 0);
+        hash->update(word, sizeof(word)); // secret
+        hash->update(word, sizeof(word)); // associated data
+        hash->final(h0);
+    }
+
+    Instance instance(memlimit / (SYNC_POINTS * lanes) * SYNC_POINTS * lanes, iterations, lanes);
+
+    quint8 bytes[sizeof(Block)];
+    for (quint32 lane = 0; lane < lanes; ++lane) {
+        for (quint32 i = 0; i < 2; ++i) {
+            storeLE32(h0 + 64, i);
+            storeLE32(h0 + 68, lane);
+            blake2bLong(bytes, sizeof(bytes), h0, sizeof(h0));
+            for (quint32 w = 0; w < BLOCK_WORDS; ++w)
+                instance.block(lane, i).v[w] = loadLE64(bytes + 8 * w);
+        }
+    }
+
+    // every segment of a slice is independent, the slices are not
+    if (threads == 0)
+        threads = qMax(thread::hardware_concurrency(), 1u);
+    threads = qMin(threads, lanes);
+    for (quint32 pass = 0; pass < iterations; ++pass) {
+        for (quint32 slice = 0; slice < SYNC_POINTS; ++slice) {
+            if (threads == 1) {
+                for (quint32 lane = 0; lane < lanes; ++lane)
+                    instance.fillSegment(pass, slice, lane);
+                continue;
+            }
+
+            vector<thread> workers;
+            for (quint32 t = 0; t < threads; ++t) {
+                workers.emplace_back([&, t] {
+                    for (auto lane = t; lane < lanes; lane += threads)
+                        instance.fillSegment(pass, slice, lane);
+                });
+            }
+            for (auto &worker : workers)
+                worker.join();
+        }
+    }
+
+    // XOR of the last block of every lane
+    Block last = instance.block(0, instance.laneLength() - 1);
+    for (quint32 lane = 1; lane < lanes; ++lane) {
+        const auto &lane_last = instance.block(lane, instance.laneLength() - 1);
+        for (quint32 w = 0; w < BLOCK_WORDS; ++w)
+            last.v[w] ^= lane_last.v[w];
+    }
+    for (quint32 w = 0; w < BLOCK_WORDS; ++w)
+        storeLE64(bytes + 8 * w, last.v[w]);
+
+    blake2bLong(output, outputLength, bytes, sizeof(bytes));
+
+    secure_scrub_memory(h0, sizeof(h0));
+    secure_scrub_memory(bytes, sizeof(bytes));
+    secure_scrub_memory(&last, sizeof(last));
+}
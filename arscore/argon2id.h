@@ -0,0 +1,30 @@
+#pragma once
+
+#include <QtGlobal>
+#include <cstddef>
+
+#include "libexport.h"
+
+/* Argon2id (RFC 9106, version 0x13) with the lanes filled in parallel.
+ *
+ * Botan 2 computes every lane of Argon2 in the calling thread, so p > 1 is no
+ * faster than p = 1. Here each lane of a segment runs on its own thread and the
+ * threads meet at the four sync points of every pass, as the RFC intends.
+ * The output is the standard Argon2id one: the same as Botan's
+ * PasswordHashFamily "Argon2id" for the same parameters.
+ */
+class LIB_EXPORT Argon2id {
+  public:
+    // memlimit in KiB, at least 8 * lanes. At most min(threads, lanes) threads
+    // run at once, threads = 0 means one per core.
+    static void derive(quint8 *output,
+                       size_t outputLength,
+                       const char *password,
+                       size_t passwordLength,
+                       const quint8 *salt,
+                       size_t saltLength,
+                       quint32 memlimit,
+                       quint32 iterations,
+                       quint32 lanes,
+                       quint32 threads = 0);
+};
@@ -0,0 +1,129 @@
+#include "argoncalibration.h"
+
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QThread>
+
+#include "botan_all.h"
+#include "cryptoengine.h"
+
+using namespace Botan;
+
+QJsonObject ArgonParams::toJson() const
+{
+    QJsonObject json;
+    json["memlimit_kib"] = static_cast<qint64>(memlimit);
+    json["iterations"]   = static_cast<qint64>(iterations);
+    json["parallelism"]  = static_cast<qint64>(parallelism);
+    json["milliseconds"] = milliseconds;
+    return (json);
+}
+
+ArgonCalibration::ArgonCalibration(quint32 targetMs)
+    : m_targetMs(targetMs)
+{
+}
+
+void ArgonCalibration::setMaxMemlimit(quint32 memlimit)
+{
+    m_maxMemlimit = qMax(memlimit, m_const->MEMLIMIT_INTERACTIVE);
+}
+
+void ArgonCalibration::setParallelism(quint32 parallelism)
+{
+    m_parallelism = parallelism > 0 ? qMin(parallelism, m_const->PARALLELISM_MAX) : 0;
+}
+
+void ArgonCalibration::setProgressCallback(std::function<void(const ArgonParams &)> callback)
+{
+    m_progress = std::move(callback);
+}
+
+ArgonParams ArgonCalibration::calibrate()
+{
+    m_measures.clear();
+
+    // never weaker than the interactive preset, even if it misses the target
+    auto best        = m_parallelism > 0 ? run(m_const->MEMLIMIT_INTERACTIVE, m_const->ITERATION_INTERACTIVE, m_parallelism) : pickLanes();
+    const auto lanes = best.parallelism;
+
+    // then memory: doubling it about doubles the time
+    while (best.memlimit <= m_maxMemlimit / 2 && best.milliseconds * 2 <= m_targetMs) {
+        const auto next = run(best.memlimit * 2, best.iterations, lanes);
+        if (next.milliseconds > m_targetMs)
+            break;
+        best = next;
+    }
+
+    // then iterations, predicted from the time of one pass
+    auto iterations = qMin<qint64>(m_const->ITERATION_CALIBRATION_MAX,
+                                   m_targetMs * best.iterations / qMax<qint64>(best.milliseconds, 1));
+    while (iterations > best.iterations) {
+        const auto next = run(best.memlimit, static_cast<quint32>(iterations), lanes);
+        if (next.milliseconds <= m_targetMs) {
+            best = next;
+            break;
+        }
+        --iterations;
+    }
+
+    m_result = best;
+    return (m_result);
+}
+
+qint64 ArgonCalibration::measure(quint32 memlimit, quint32 iterations, quint32 parallelism)
+{
+    AutoSeeded_RNG rng;
+    CryptoEngine engine;
+    engine.setSalt(rng.random_vec(consts::ARGON_SALT_LEN));
+
+    QElapsedTimer timer;
+    timer.start();
+    engine.derivePassword("calibration", memlimit, iterations, parallelism);
+    return (timer.elapsed());
+}
+
+QJsonObject ArgonCalibration::toJson() const
+{
+    QJsonArray measures;
+    for (const auto &params : m_measures)
+        measures.append(params.toJson());
+
+    QJsonObject json;
+    json["target_ms"]    = static_cast<qint64>(m_targetMs);
+    json["max_memlimit"] = static_cast<qint64>(m_maxMemlimit);
+    json["result"]       = m_result.toJson();
+    json["measures"]     = measures;
+    return (json);
+}
+
+ArgonParams ArgonCalibration::pickLanes()
+{
+    const auto cores = static_cast<quint32>(qBound(1, QThread::idealThreadCount(), static_cast<int>(m_const->PARALLELISM_MAX)));
+
+    // on a tie the fewer lanes win, they don't wait for each other
+    ArgonParams fastest;
+    fastest.milliseconds = -1;
+    for (quint32 lanes = 1;; lanes = qMin(lanes * 2, cores)) {
+        const auto params = run(m_const->MEMLIMIT_INTERACTIVE, m_const->ITERATION_INTERACTIVE, lanes);
+        if (fastest.milliseconds < 0 || params.milliseconds < fastest.milliseconds)
+            fastest = params;
+        if (lanes == cores)
+            break;
+    }
+    return (fastest);
+}
+
+ArgonParams ArgonCalibration::run(quint32 memlimit, quint32 iterations, quint32 parallelism)
+{
+    ArgonParams params;
+    params.memlimit     = memlimit;
+    params.iterations   = iterations;
+    params.parallelism  = parallelism;
+    params.milliseconds = measure(memlimit, iterations, parallelism);
+
+    m_measures.append(params);
+    if (m_progress)
+        m_progress(params);
+    return (params);
+}
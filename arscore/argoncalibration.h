@@ -0,0 +1,64 @@
+#pragma once
+
+#include <QJsonObject>
+#include <QList>
+#include <functional>
+#include <memory>
+
+#include "consts.h"
+#include "libexport.h"
+
+struct ArgonParams {
+    quint32 memlimit    = consts::MEMLIMIT_INTERACTIVE; // KiB
+    quint32 iterations  = consts::ITERATION_INTERACTIVE;
+    quint32 parallelism = consts::PARALLELISM_DEFAULT;
+    qint64 milliseconds = 0; // measured derivation time
+
+    QJsonObject toJson() const;
+};
+
+/* Pick the strongest Argon2id parameters that fit a target latency on this
+ * machine, by timing CryptoEngine::derivePassword.
+ *
+ * The lane count comes first: the interactive preset is timed with 1, 2, 4...
+ * lanes up to one per core (PARALLELISM_MAX at most), and the fastest is
+ * kept, it leaves the most room for the rest. Memory is raised next
+ * (doubling from MEMLIMIT_INTERACTIVE while the next step still fits the
+ * target and the memory cap), then the iterations with the memory fixed. The
+ * derivation time is about linear in both, so every step is predicted from
+ * the last measure and then checked.
+ */
+class LIB_EXPORT ArgonCalibration {
+  public:
+    explicit ArgonCalibration(quint32 targetMs = consts::CALIBRATION_TARGET_MS);
+
+    // upper bound of the memlimit in KiB, MEMLIMIT_CALIBRATION_MAX by default
+    void setMaxMemlimit(quint32 memlimit);
+    // Argon2 lanes used for every measure, 0 (default) picks them as above
+    void setParallelism(quint32 parallelism);
+    // called after every measure, e.g. to keep a GUI responsive
+    void setProgressCallback(std::function<void(const ArgonParams &)> callback);
+
+    ArgonParams calibrate();
+
+    // time one derivation with these parameters
+    static qint64 measure(quint32 memlimit, quint32 iterations, quint32 parallelism);
+
+    // the target, the result and every measure of the last calibrate()
+    QJsonObject toJson() const;
+
+  private:
+    // the fastest measure of the interactive preset over the lane counts
+    ArgonParams pickLanes();
+    ArgonParams run(quint32 memlimit, quint32 iterations, quint32 parallelism);
+
+    quint32 m_targetMs;
+    quint32 m_maxMemlimit = consts::MEMLIMIT_CALIBRATION_MAX;
+    quint32 m_parallelism = 0;
+    std::function<void(const ArgonParams &)> m_progress;
+
+    ArgonParams m_result;
+    QList<ArgonParams> m_measures;
+
+    const std::unique_ptr<consts> m_const;
+};
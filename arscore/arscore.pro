@@ -8,10 +8,24 @@ DEFINES += EXPORT_LIB
 
 HEADERS += \
     CryptoThread.h \
+    archivestream.h \
+    argon2id.h \
+    argoncalibration.h \
+    chunkpipeline.h \
+    chunkqueue.h \
     cryptoengine.h \
     dict-src.h \
+    directfile.h \
+    directorywalker.h \
+    fileheader.h \
+    inspection.h \
+    ioengine.h \
+    jobscheduler.h \
+    journal.h \
+    keycache.h \
     libexport.h \
     passwordGenerator.h \
+    ringqueue.h \
     textcrypto.h \
     utils.h \
     consts.h \
@@ -20,7 +34,19 @@ HEADERS += \
 
 SOURCES += \
     CryptoThread.cpp \
+    archivestream.cpp \
+    argon2id.cpp \
+    argoncalibration.cpp \
+    chunkpipeline.cpp \
     cryptoengine.cpp \
+    directfile.cpp \
+    directorywalker.cpp \
+    fileheader.cpp \
+    inspection.cpp \
+    ioengine.cpp \
+    jobscheduler.cpp \
+    journal.cpp \
+    keycache.cpp \
     passwordGenerator.cpp \
     textcrypto.cpp \
     utils.cpp \
@@ -0,0 +1,879 @@
+#include "chunkpipeline.h"
+
+#include <QByteArray>
+#include <QDataStream>
+#include <QFileDevice>
+#include <QtEndian>
+#include <cstring>
+#include <set>
+
+#include "messages.h"
+
+using namespace Botan;
+using namespace std;
+
+ChunkPipeline::ChunkPipeline(bool direction, const SecureVector<quint8> &key, quint32 threads)
+    : m_direction(direction),
+      m_key(key),
+      m_threads(threads > 0 ? threads : 1),
+      m_maxInFlight(m_threads * 4),
+      m_free(m_maxInFlight),
+      m_work(m_maxInFlight),
+      m_slots(m_maxInFlight),
+      m_ready(m_maxInFlight)
+{
+}
+
+ChunkPipeline::~ChunkPipeline()
+{
+    stop();
+}
+
+void ChunkPipeline::setProgressCallback(function<void(qint64)> callback)
+{
+    m_progress = move(callback);
+}
+
+void ChunkPipeline::setAbortCallback(function<bool()> callback)
+{
+    m_aborted = move(callback);
+}
+
+void ChunkPipeline::setChunkLimit(quint64 chunks)
+{
+    m_chunkLimit = chunks;
+}
+
+void ChunkPipeline::setInputLimit(qint64 end)
+{
+    m_inputLimit = end;
+}
+
+void ChunkPipeline::setOutputWindow(qint64 skip, qint64 length)
+{
+    m_skip   = skip;
+    m_length = length;
+}
+
+void ChunkPipeline::setChunkSize(quint32 chunkSize)
+{
+    m_chunkSize = chunkSize;
+}
+
+void ChunkPipeline::setMemoryMapped(bool mapped)
+{
+    m_memoryMapped = mapped;
+}
+
+void ChunkPipeline::setDirectIo(bool direct)
+{
+    m_directIo = direct;
+}
+
+void ChunkPipeline::setIoDepth(quint32 depth)
+{
+    m_ioDepth = qMin(depth, m_const->IO_DEPTH_MAX);
+}
+
+void ChunkPipeline::setMemoryBudget(quint64 memory)
+{
+    m_memoryBudget = memory;
+}
+
+quint64 ChunkPipeline::memoryUsage() const
+{
+    return (static_cast<quint64>(fixedMemory() + poolSize() * bufferSize()));
+}
+
+quint32 ChunkPipeline::threads() const
+{
+    return (m_threads);
+}
+
+void ChunkPipeline::setFinalChunk(bool finalChunk)
+{
+    m_finalChunk = finalChunk;
+}
+
+void ChunkPipeline::setCompression(quint32 codec)
+{
+    m_compression = codec;
+}
+
+void ChunkPipeline::setCheckpointCallback(function<void(quint64, const SecureVector<quint8> &)> callback,
+                                          quint64 interval,
+                                          const SecureVector<quint8> &state)
+{
+    m_checkpoint         = move(callback);
+    m_checkpointInterval = qMax<quint64>(interval, 1);
+    m_tagState           = state;
+}
+
+quint32 ChunkPipeline::run(QIODevice &src, QIODevice &des, const SecureVector<quint8> &nonce, quint64 firstIndex)
+{
+    m_nonce      = nonce;
+    m_firstIndex = firstIndex;
+    m_truncated  = false;
+    m_readFailed = false;
+    m_inputLeft  = m_inputLimit >= 0 ? qMax<qint64>(m_inputLimit - src.pos(), 0) : -1;
+    const auto framed = m_compression != m_const->COMPRESSION_NONE;
+    const auto direct = m_directIo && !m_checkpoint;
+    const auto mapped = m_memoryMapped && !direct && !m_finalChunk && !framed && !m_checkpoint && mapFiles(src, des);
+    m_mapped          = mapped;
+    if (direct)
+        openDirect(src, des);
+    else if (m_ioDepth > 0 && !mapped && !m_finalChunk && !framed && IoEngine::supported())
+        openAsync(src, des);
+    auto &input  = m_directInput ? static_cast<QIODevice &>(*m_directInput) : src;
+    auto &output = m_directOutput ? static_cast<QIODevice &>(*m_directOutput) : des;
+
+    // the whole buffer pool is allocated here, as many buffers as the memory
+    // budget allows: the reader waits for one to come back past that
+    const auto pool = poolSize();
+    m_poolBuffers   = 0;
+    for (quint32 i = 0; i < pool; ++i) {
+        SecureVector<quint8> buffer;
+        buffer.reserve(bufferSize());
+        m_free.push(move(buffer));
+        ++m_poolBuffers;
+    }
+
+    m_reader = thread(&ChunkPipeline::readChunks, this, ref(input));
+    for (quint32 i = 0; i < m_threads; ++i)
+        m_workers.emplace_back(&ChunkPipeline::processChunks, this);
+
+    // the chunks written asynchronously keep their buffer until the write is
+    // done, in the slot of their tag
+    unique_ptr<IoEngine> writer;
+    vector<SecureVector<quint8>> writing;
+    vector<quint32> writeSlots;
+    if (m_outputFd >= 0) {
+        writer = make_unique<IoEngine>(m_ioDepth);
+        writing.resize(writer->depth());
+        for (quint32 i = 0; i < writer->depth(); ++i)
+            writeSlots.push_back(i);
+    }
+    auto writeError    = false;
+    const auto recycle = [&](bool wait) {
+        IoCompletion completion;
+        if (!(wait ? writer->complete(completion) : writer->tryComplete(completion)))
+            return (false);
+        writeError |= completion.result < 0;
+        writing[completion.tag].clear();
+        m_free.push(move(writing[completion.tag]));
+        writeSlots.push_back(static_cast<quint32>(completion.tag));
+        return (true);
+    };
+
+    // the ordered writer runs in the calling thread
+    QDataStream des_stream(&output);
+    des_stream.setVersion(QDataStream::Qt_5_0);
+
+    quint32 result   = m_direction ? CRYPT_SUCCESS : DECRYPT_SUCCESS;
+    qint64 processed = 0;
+    qint64 written   = 0;
+    qint64 dropped   = m_cachedOutput ? des.pos() : 0;
+    quint64 next     = 0;
+    auto end         = false;
+
+    while (true) {
+        Chunk chunk;
+        const auto slot = next % m_maxInFlight;
+
+        // the buffers of the writes done go back before waiting, the reader
+        // may need them for the next chunk. One write at a time is waited
+        // for, and only while the next chunk isn't there: the others stay
+        // in flight behind it.
+        if (writer) {
+            while (recycle(false)) {
+            }
+            while (writer->inFlight() > 0 && !chunkReady(slot, next))
+                recycle(true);
+        }
+
+        waitChunk(slot, next);
+        if (m_failed) {
+            result = m_direction ? CRYPT_FAIL : DECRYPT_FAIL;
+            break;
+        }
+        if (!m_ready[slot].ready.load(memory_order_acquire))
+            break; // every chunk is written
+
+        // no worker fills the slot again before the buffer of this chunk
+        // goes back to the reader
+        chunk = move(m_slots[slot]);
+        m_ready[slot].ready.store(false, memory_order_relaxed);
+
+        if (m_aborted && m_aborted()) {
+            result = ABORTED_BY_USER;
+            break;
+        }
+
+        // nothing may follow the end of a compressed file
+        if (end) {
+            result = DECRYPT_FAIL;
+            break;
+        }
+        end = !m_direction && chunk.last;
+
+        // the length of an encrypted block goes first, they don't have a fixed size
+        if (framed && m_direction)
+            des_stream << static_cast<quint32>(chunk.data.size());
+
+        // only keep the part of the output inside the window
+        qint64 begin = 0;
+        qint64 size  = chunk.data.size();
+        if (next == 0) {
+            begin = qMin(m_skip, size);
+            size -= begin;
+        }
+        if (m_length >= 0)
+            size = qMin(size, m_length - written);
+
+        if (mapped) {
+            memcpy(m_output + written, chunk.data.data() + begin, size);
+        }
+        else if (writer) {
+            if (writer->inFlight() == writer->depth())
+                recycle(true);
+            const auto writeSlot = writeSlots.back();
+            writeSlots.pop_back();
+            writing[writeSlot] = move(chunk.data);
+            if (writeError || !writer->submit(IoRequest{m_outputFd, true, writing[writeSlot].data() + begin, size, m_outputBase + written, writeSlot})) {
+                result = DES_CANNOT_OPEN_WRITE;
+                break;
+            }
+        }
+        else if (des_stream.writeRawData(reinterpret_cast<char *>(chunk.data.data()) + begin, size) < 0) {
+            result = DES_CANNOT_OPEN_WRITE;
+            break;
+        }
+        written += size;
+        dropCache(m_cachedOutput, dropped);
+
+        processed += m_direction ? chunk.plainSize : size;
+        if (m_progress)
+            m_progress(processed);
+        ++next;
+
+        // the output is written up to here, a rerun may start from the next chunk
+        if (m_checkpoint) {
+            chainTags(m_tagState, chunk.tags.data());
+            if (!chunk.last && next % m_checkpointInterval == 0) {
+                while (writer && writer->inFlight() > 0)
+                    recycle(true);
+                if (writeError) {
+                    result = DES_CANNOT_OPEN_WRITE;
+                    break;
+                }
+                m_checkpoint(m_firstIndex - 1 + next, m_tagState);
+            }
+        }
+
+        // give the buffer back to the reader, or when it is written
+        if (!writer) {
+            chunk.data.clear();
+            m_free.push(move(chunk.data));
+        }
+
+        if (m_length >= 0 && written >= m_length)
+            break;
+    }
+
+    if (writer) {
+        while (writer->inFlight() > 0)
+            recycle(true);
+        writer.reset();
+        if (writeError && (result == CRYPT_SUCCESS || result == DECRYPT_SUCCESS))
+            result = DES_CANNOT_OPEN_WRITE;
+        des.seek(m_outputBase + written);
+    }
+
+    stop();
+    if (mapped)
+        unmapFiles(src, des, written);
+
+    // the last block of the output is still in the DirectFile buffer
+    if (m_directOutput) {
+        m_directOutput->close();
+        des.seek(m_directOutput->position());
+        if (m_directOutput->failed() && (result == CRYPT_SUCCESS || result == DECRYPT_SUCCESS))
+            result = DES_CANNOT_OPEN_WRITE;
+    }
+    if ((m_readFailed || (m_directInput && m_directInput->failed())) && (result == CRYPT_SUCCESS || result == DECRYPT_SUCCESS))
+        result = SRC_CANNOT_OPEN_READ;
+    m_directInput.reset();
+    m_directOutput.reset();
+    m_cachedInput  = nullptr;
+    m_cachedOutput = nullptr;
+    m_inputFd      = -1;
+    m_outputFd     = -1;
+    if (result == DECRYPT_SUCCESS && m_truncated)
+        result = DECRYPT_FAIL;
+    // a compressed file cut between two blocks
+    if (result == DECRYPT_SUCCESS && framed && !end && m_chunkLimit == 0 && m_length < 0)
+        result = DECRYPT_FAIL;
+    return (result);
+}
+
+quint64 ChunkPipeline::poolBuffers() const
+{
+    return (m_poolBuffers);
+}
+
+bool ChunkPipeline::mapped() const
+{
+    return (m_mapped);
+}
+
+qint64 ChunkPipeline::bufferSize() const
+{
+    // room for the three tags and the flag of a compressed chunk
+    const auto framed = m_compression != m_const->COMPRESSION_NONE;
+    return (m_chunkSize + m_const->MACBYTES * 3 + (framed ? 1 : 0));
+}
+
+qint64 ChunkPipeline::fixedMemory() const
+{
+    // the staging buffers of DirectFile, and a chunk being (un)compressed
+    // by every worker
+    qint64 memory = 0;
+    if (m_directIo && !m_checkpoint)
+        memory += m_const->DIRECT_IO_BUFFER * 2;
+    if (m_compression != m_const->COMPRESSION_NONE)
+        memory += static_cast<qint64>(m_threads) * bufferSize();
+    return (memory);
+}
+
+quint32 ChunkPipeline::poolSize() const
+{
+    if (m_memoryBudget == 0)
+        return (m_maxInFlight);
+
+    // one buffer being read and one being written at least
+    const auto budget  = static_cast<qint64>(m_memoryBudget) - fixedMemory();
+    const auto buffers = budget > 0 ? budget / bufferSize() : 0;
+    return (static_cast<quint32>(qBound<qint64>(2, buffers, m_maxInFlight)));
+}
+
+quint32 ChunkPipeline::adaptiveChunkSize(qint64 fileSize)
+{
+    quint32 chunkSize = consts::MIN_CHUNK_SIZE;
+    while (chunkSize < consts::MAX_CHUNK_SIZE && fileSize / chunkSize > consts::CHUNKS_PER_FILE)
+        chunkSize *= 2;
+    return (chunkSize);
+}
+
+void ChunkPipeline::readChunks(QIODevice &src)
+{
+    const auto framed   = m_compression != m_const->COMPRESSION_NONE;
+    const auto readSize = m_direction ? m_chunkSize : m_chunkSize + m_const->MACBYTES * 3 + (framed ? 1 : 0);
+    QDataStream src_stream(&src);
+    quint64 index      = 0;
+    qint64 inputOffset = 0;
+    qint64 dropped     = m_cachedInput ? m_cachedInput->pos() : 0;
+    auto lastFull      = false;
+    auto end           = false;
+    Chunk chunk;
+
+    if (m_inputFd >= 0)
+        index = readAsync();
+
+    while (m_inputFd < 0 && !m_stop && (m_chunkLimit == 0 || index < m_chunkLimit)) {
+        // blocks until the writer recycles a buffer, so the reader is never
+        // more than m_maxInFlight chunks ahead
+        if (!m_free.pop(chunk.data))
+            break;
+
+        // never past the input limit, whatever follows is not a block
+        const auto wanted = m_inputLeft >= 0 ? qMin<qint64>(readSize, m_inputLeft) : readSize;
+        chunk.data.resize(readSize);
+        qint64 bytes_read = 0;
+        if (m_input) {
+            bytes_read = qMin<qint64>(wanted, m_inputSize - inputOffset);
+            if (bytes_read > 0)
+                memcpy(chunk.data.data(), m_input + inputOffset, bytes_read);
+            inputOffset += bytes_read;
+        }
+        else if (framed && !m_direction) {
+            // every block is preceded by its length, none is empty
+            uchar prefix[4] = {};
+            const auto prefixSize = wanted > 0 ? readFull(src_stream, reinterpret_cast<char *>(prefix), m_const->CHUNK_LENGTH_LEN) : 0;
+            const auto length     = qFromBigEndian<quint32>(prefix);
+            if (prefixSize > 0) {
+                if (prefixSize != m_const->CHUNK_LENGTH_LEN || length <= m_const->MACBYTES * 3 || length > readSize
+                    || (m_inputLeft >= 0 && prefixSize + length > m_inputLeft)) {
+                    m_truncated = true;
+                    break;
+                }
+                bytes_read = readFull(src_stream, reinterpret_cast<char *>(chunk.data.data()), length);
+                if (bytes_read != length) {
+                    m_truncated = true;
+                    break;
+                }
+                if (m_inputLeft >= 0)
+                    m_inputLeft -= prefixSize;
+            }
+        }
+        else if (wanted > 0) {
+            bytes_read = readFull(src_stream, reinterpret_cast<char *>(chunk.data.data()), wanted);
+        }
+        if (bytes_read <= 0) {
+            end = true;
+            break;
+        }
+        if (m_inputLeft >= 0)
+            m_inputLeft -= bytes_read;
+
+        lastFull = bytes_read == readSize;
+        chunk.data.resize(bytes_read);
+        dropCache(m_cachedInput, dropped);
+        chunk.index = index++;
+
+        if (!m_work.push(move(chunk)))
+            break;
+    }
+
+    // a compressed file ends with a CHUNK_END block, see processChunks
+    if (framed && end) {
+        if (m_direction) {
+            chunk.data.clear();
+            chunk.index = index;
+            chunk.last  = true;
+            if (m_work.push(move(chunk)))
+                ++index;
+        }
+    }
+    // the last chunk of a stream is always short
+    else if (m_finalChunk && end && (index == 0 || lastFull)) {
+        if (m_direction) {
+            chunk.data.clear();
+            chunk.index = index;
+            if (m_work.push(move(chunk)))
+                ++index;
+        }
+        else {
+            m_truncated = true;
+        }
+    }
+
+    m_chunkCount.store(index, memory_order_relaxed);
+    m_readerFinished.store(true, memory_order_release);
+    wakeWriter();
+    m_work.close();
+}
+
+quint64 ChunkPipeline::readAsync()
+{
+    // every block has a fixed size, its offset only depends on its index
+    const qint64 readSize = m_direction ? m_chunkSize : m_chunkSize + m_const->MACBYTES * 3;
+    auto chunks           = static_cast<quint64>((m_inputEnd - m_inputBase + readSize - 1) / readSize);
+    if (m_chunkLimit > 0)
+        chunks = qMin(chunks, m_chunkLimit);
+
+    // declared before the engine, which waits for the reads in flight
+    vector<Chunk> reading;
+    vector<quint32> readSlots;
+    IoEngine engine(m_ioDepth);
+    reading.resize(engine.depth());
+    for (quint32 i = 0; i < engine.depth(); ++i)
+        readSlots.push_back(i);
+
+    quint64 submitted  = 0;
+    quint64 read       = 0;
+    quint64 contiguous = 0; // the chunks before it were all handed out
+    auto failed        = false;
+    set<quint64> ahead;
+    while (!failed && !m_stop && read < chunks) {
+        // a buffer may only come back once a read in flight is done
+        while (!m_stop && submitted < chunks && engine.inFlight() < engine.depth()) {
+            const auto slot = readSlots.back();
+            auto &chunk     = reading[slot];
+            if (engine.inFlight() > 0 ? !m_free.tryPop(chunk.data) : !m_free.pop(chunk.data))
+                break;
+
+            const auto offset = m_inputBase + static_cast<qint64>(submitted) * readSize;
+            chunk.data.resize(qMin(readSize, m_inputEnd - offset));
+            chunk.index = submitted;
+            if (!engine.submit(IoRequest{m_inputFd, false, chunk.data.data(), static_cast<qint64>(chunk.data.size()), offset, slot})) {
+                failed = true;
+                break;
+            }
+            readSlots.pop_back();
+            ++submitted;
+        }
+
+        IoCompletion completion;
+        if (failed || !engine.complete(completion))
+            break;
+
+        // the file shrank since the run started
+        auto &chunk = reading[completion.tag];
+        if (completion.result != static_cast<qint64>(chunk.data.size()))
+            break;
+        readSlots.push_back(static_cast<quint32>(completion.tag));
+        ++read;
+        const auto index = chunk.index;
+        if (!m_work.push(move(chunk)))
+            break;
+
+        // the reads end in any order
+        ahead.insert(index);
+        while (ahead.erase(contiguous) > 0)
+            ++contiguous;
+    }
+
+    // a read or a submission failed: the run must not end as a success with
+    // the output cut short. The writer stops before the first chunk that
+    // didn't make it.
+    if (read < chunks && !m_stop)
+        m_readFailed = true;
+    return (contiguous);
+}
+
+void ChunkPipeline::processChunks()
+{
+    CryptoEngine engine(m_direction);
+    engine.setKey(m_key);
+    engine.setNonce(m_nonce);
+    const auto framed = m_compression != m_const->COMPRESSION_NONE;
+
+    while (!m_stop) {
+        Chunk chunk;
+        if (!m_work.pop(chunk))
+            break;
+
+        const auto capacity = chunk.data.capacity();
+        chunk.plainSize     = chunk.data.size();
+        auto valid          = true;
+        try {
+            if (framed && m_direction)
+                packChunk(chunk);
+            if (m_checkpoint && !m_direction && chunk.data.size() >= chunk.tags.size())
+                memcpy(chunk.tags.data(), chunk.data.data() + chunk.data.size() - chunk.tags.size(), chunk.tags.size());
+            engine.setChunkIndex(m_firstIndex + chunk.index);
+            engine.finish(chunk.data);
+            if (m_checkpoint && m_direction)
+                memcpy(chunk.tags.data(), chunk.data.data() + chunk.data.size() - chunk.tags.size(), chunk.tags.size());
+            if (framed && !m_direction)
+                valid = unpackChunk(chunk);
+        }
+        // a failed authentication, or std::bad_alloc from the (un)compression:
+        // nothing may leave a worker thread
+        catch (const std::exception &) {
+            valid = false;
+        }
+
+        if (!valid) {
+            m_failed = true;
+            wakeWriter();
+            break;
+        }
+
+        if (chunk.data.capacity() != capacity)
+            ++m_poolBuffers;
+
+        const auto slot = chunk.index % m_maxInFlight;
+        m_slots[slot]   = move(chunk);
+        m_ready[slot].ready.store(true, memory_order_release);
+        wakeWriter();
+    }
+}
+
+bool ChunkPipeline::chunkReady(quint64 slot, quint64 next) const
+{
+    return (m_failed || m_ready[slot].ready.load(memory_order_acquire) ||
+            (m_readerFinished.load(memory_order_acquire) && next == m_chunkCount.load(memory_order_relaxed)));
+}
+
+void ChunkPipeline::waitChunk(quint64 slot, quint64 next)
+{
+    // a few tries before sleeping, the worker is often about to be done
+    for (int i = 0; i < 64; ++i) {
+        if (chunkReady(slot, next))
+            return;
+        if (i >= 16)
+            this_thread::yield();
+    }
+
+    // counted before the last look, wakeWriter() looks at the count after
+    // publishing: one of them sees the other (see ChunkQueue)
+    unique_lock<mutex> lock(m_doneMutex);
+    m_writerWaiting.fetch_add(1);
+    atomic_thread_fence(memory_order_seq_cst);
+    m_doneCond.wait(lock, [&] { return chunkReady(slot, next); });
+    m_writerWaiting.fetch_sub(1);
+}
+
+void ChunkPipeline::wakeWriter()
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    if (m_writerWaiting.load(memory_order_relaxed) == 0)
+        return;
+    lock_guard<mutex> lock(m_doneMutex);
+    m_doneCond.notify_one();
+}
+
+void ChunkPipeline::packChunk(Chunk &chunk) const
+{
+    if (chunk.last) {
+        chunk.data.assign(1, m_const->CHUNK_END);
+        return;
+    }
+
+    // keep the plaintext when it doesn't get smaller, the flag tells which
+    auto packed = qCompress(chunk.data.data(), static_cast<int>(chunk.data.size()), m_const->COMPRESSION_LEVEL);
+    if (static_cast<size_t>(packed.size()) < chunk.data.size()) {
+        chunk.data.resize(packed.size() + 1);
+        chunk.data[0] = m_const->CHUNK_ZLIB;
+        memcpy(chunk.data.data() + 1, packed.constData(), packed.size());
+    }
+    else {
+        chunk.data.insert(chunk.data.begin(), m_const->CHUNK_RAW);
+    }
+
+    // QByteArray doesn't wipe its memory like a SecureVector
+    packed.fill(0);
+}
+
+bool ChunkPipeline::unpackChunk(Chunk &chunk) const
+{
+    if (chunk.data.empty())
+        return (false);
+
+    const auto flag = chunk.data[0];
+    if (flag == m_const->CHUNK_END) {
+        chunk.last = true;
+        chunk.data.clear();
+        return (true);
+    }
+
+    if (flag == m_const->CHUNK_RAW) {
+        chunk.data.erase(chunk.data.begin());
+        return (!chunk.data.empty());
+    }
+
+    // qCompress stores the size of the plaintext first, big-endian
+    const auto size = chunk.data.size() - 1;
+    if (flag != m_const->CHUNK_ZLIB || size <= 4)
+        return (false);
+    const auto plainSize = qFromBigEndian<quint32>(chunk.data.data() + 1);
+    if (plainSize == 0 || plainSize > m_chunkSize)
+        return (false);
+
+    auto plain = qUncompress(chunk.data.data() + 1, static_cast<int>(size));
+    const auto valid = static_cast<quint32>(plain.size()) == plainSize;
+    if (valid)
+        chunk.data.assign(plain.constData(), plain.constData() + plain.size());
+    plain.fill(0);
+    return (valid);
+}
+
+qint64 ChunkPipeline::readFull(QDataStream &stream, char *data, qint64 size)
+{
+    // a pipe returns what it has, read up to size or the end of the device
+    qint64 done = 0;
+    while (done < size) {
+        const auto bytes = stream.readRawData(data + done, static_cast<int>(size - done));
+        if (bytes <= 0)
+            break;
+        done += bytes;
+    }
+    return (done);
+}
+
+bool ChunkPipeline::skipChunks(QIODevice &src, quint64 chunks, quint32 chunkSize)
+{
+    const auto maxLength = chunkSize + consts::MACBYTES * 3 + 1;
+    for (quint64 i = 0; i < chunks; ++i) {
+        uchar prefix[4];
+        if (src.read(reinterpret_cast<char *>(prefix), consts::CHUNK_LENGTH_LEN) != consts::CHUNK_LENGTH_LEN)
+            return (false);
+        const auto length = qFromBigEndian<quint32>(prefix);
+        if (length > maxLength || !src.seek(src.pos() + length))
+            return (false);
+    }
+    return (true);
+}
+
+void ChunkPipeline::chainTags(SecureVector<quint8> &state, const quint8 *tags)
+{
+    auto hash = HashFunction::create_or_throw("SHA-256");
+    if (state.size() != consts::TAG_STATE_LEN)
+        state.assign(consts::TAG_STATE_LEN, 0);
+    hash->update(state);
+    hash->update(tags, consts::MACBYTES * 3);
+    state = hash->final();
+}
+
+bool ChunkPipeline::replayTags(QIODevice &src, quint64 chunks, quint32 chunkSize, bool compressed, SecureVector<quint8> &state)
+{
+    const qint64 tagSize = consts::MACBYTES * 3;
+    const qint64 block   = chunkSize + tagSize;
+    quint8 tags[consts::MACBYTES * 3];
+
+    for (quint64 i = 0; i < chunks; ++i) {
+        // the length of a compressed block is before it, the last block
+        // of an uncompressed file may be short
+        qint64 length = qMin(block, src.size() - src.pos());
+        if (compressed) {
+            uchar prefix[4] = {};
+            if (src.read(reinterpret_cast<char *>(prefix), consts::CHUNK_LENGTH_LEN) != consts::CHUNK_LENGTH_LEN)
+                return (false);
+            length = qFromBigEndian<quint32>(prefix);
+        }
+
+        const auto end = src.pos() + length;
+        if (length < tagSize || length > block + 1 || end > src.size())
+            return (false);
+        if (!src.seek(end - tagSize) || src.read(reinterpret_cast<char *>(tags), tagSize) != tagSize)
+            return (false);
+        chainTags(state, tags);
+    }
+    return (true);
+}
+
+void ChunkPipeline::stop()
+{
+    m_stop = true;
+    wakeWriter();
+    m_free.close();
+    m_work.close();
+
+    if (m_reader.joinable())
+        m_reader.join();
+    for (auto &worker : m_workers) {
+        if (worker.joinable())
+            worker.join();
+    }
+    m_workers.clear();
+}
+
+void ChunkPipeline::openDirect(QIODevice &src, QIODevice &des)
+{
+    auto *src_file = qobject_cast<QFileDevice *>(&src);
+    auto *des_file = qobject_cast<QFileDevice *>(&des);
+
+    // streams and archive members keep their own device
+    if (src_file && !src.isSequential()) {
+        m_directInput = make_unique<DirectFile>(src_file->fileName(), src.pos());
+        if (!m_directInput->open(QIODevice::ReadOnly)) {
+            m_directInput.reset();
+            m_cachedInput = src_file;
+            DirectFile::adviseSequential(*src_file);
+        }
+    }
+
+    if (des_file && !des.isSequential()) {
+        // the header is still in the QFile write buffer
+        des_file->flush();
+        m_directOutput = make_unique<DirectFile>(des_file->fileName(), des.pos());
+        if (!m_directOutput->open(QIODevice::WriteOnly)) {
+            m_directOutput.reset();
+            m_cachedOutput = des_file;
+        }
+    }
+}
+
+void ChunkPipeline::openAsync(QIODevice &src, QIODevice &des)
+{
+    auto *src_file = qobject_cast<QFileDevice *>(&src);
+    auto *des_file = qobject_cast<QFileDevice *>(&des);
+
+    // the engine reads and writes the file descriptors at their offsets,
+    // the QFile positions are set back after the run
+    if (src_file && !src.isSequential() && src_file->handle() >= 0) {
+        m_inputFd   = src_file->handle();
+        m_inputBase = src.pos();
+        m_inputEnd  = m_inputLeft >= 0 ? qMin(src.size(), m_inputBase + m_inputLeft) : src.size();
+    }
+
+    if (des_file && !des.isSequential() && des_file->handle() >= 0) {
+        // the header is still in the QFile write buffer
+        des_file->flush();
+        m_outputFd   = des_file->handle();
+        m_outputBase = des.pos();
+    }
+}
+
+void ChunkPipeline::dropCache(QFileDevice *file, qint64 &dropped)
+{
+    if (!file)
+        return;
+
+    const auto position = file->pos();
+    if (position - dropped >= m_const->DIRECT_IO_DROP_INTERVAL) {
+        DirectFile::dropCache(*file, dropped, position - dropped);
+        dropped = position;
+    }
+}
+
+bool ChunkPipeline::mapFiles(QIODevice &src, QIODevice &des)
+{
+    auto *src_file = qobject_cast<QFileDevice *>(&src);
+    auto *des_file = qobject_cast<QFileDevice *>(&des);
+    if (!src_file || !des_file || src.isSequential() || des.isSequential())
+        return (false);
+
+    // work out the exact size of the output so it can be mapped up front
+    const qint64 readSize = m_direction ? m_chunkSize : m_chunkSize + m_const->MACBYTES * 3;
+    const qint64 tags     = m_const->MACBYTES * 3;
+    auto inputSize        = src.size() - src.pos();
+    if (m_inputLeft >= 0)
+        inputSize = qMin(inputSize, m_inputLeft);
+    auto chunks           = (inputSize + readSize - 1) / readSize;
+    if (m_chunkLimit > 0 && chunks > static_cast<qint64>(m_chunkLimit)) {
+        chunks    = m_chunkLimit;
+        inputSize = chunks * readSize;
+    }
+
+    auto outputSize = m_direction ? inputSize + chunks * tags : inputSize - chunks * tags - m_skip;
+    if (m_length >= 0)
+        outputSize = qMin(outputSize, m_length);
+
+    // nothing to map, or a truncated file the streaming path will reject
+    if (inputSize <= 0 || outputSize <= 0)
+        return (false);
+
+    // keep clear of the 32 bits address space limits
+    if (sizeof(void *) < 8 && inputSize + outputSize > (qint64(1) << 30))
+        return (false);
+
+    // the header is still in the QFile write buffer
+    des_file->flush();
+    m_outputBase = des.pos();
+
+    m_input = src_file->map(src.pos(), inputSize);
+    if (!m_input)
+        return (false);
+
+    if (des_file->resize(m_outputBase + outputSize))
+        m_output = des_file->map(m_outputBase, outputSize);
+
+    if (!m_output) {
+        src_file->unmap(m_input);
+        m_input = nullptr;
+        des_file->resize(m_outputBase);
+        return (false);
+    }
+
+    m_inputSize  = inputSize;
+    m_outputSize = outputSize;
+    return (true);
+}
+
+void ChunkPipeline::unmapFiles(QIODevice &src, QIODevice &des, qint64 written)
+{
+    auto *src_file = qobject_cast<QFileDevice *>(&src);
+    auto *des_file = qobject_cast<QFileDevice *>(&des);
+
+    src_file->unmap(m_input);
+    des_file->unmap(m_output);
+    m_input  = nullptr;
+    m_output = nullptr;
+
+    // an aborted or failed run leaves the output shorter than planned
+    if (written != m_outputSize)
+        des_file->resize(m_outputBase + written);
+    des.seek(m_outputBase + written);
+}
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <QIODevice>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "botan_all.h"
+#include "chunkqueue.h"
+#include "consts.h"
+#include "cryptoengine.h"
+#include "directfile.h"
+#include "ioengine.h"
+#include "libexport.h"
+
+struct Chunk {
+    quint64 index    = 0;
+    qint64 plainSize = 0;     // before encryption
+    bool last        = false; // CHUNK_END of a compressed file
+    Botan::SecureVector<quint8> data;
+    std::array<quint8, consts::MACBYTES * 3> tags{}; // with a checkpoint callback only
+};
+
+/* Encrypt or decrypt the data blocks of an .arsn file on several cores.
+ *
+ * A reader thread cuts the source in numbered chunks, N worker threads (each
+ * with its own CryptoEngine key schedule) work out the nonce of every chunk
+ * from its index and run the cascade, and the calling thread writes the
+ * chunks back in order. The output is byte-identical to the serial loop.
+ * On decryption, the first authentication failure stops the whole pipeline.
+ *
+ * All chunk buffers are allocated by run() before the threads start and are
+ * recycled by the writer, so the steady state does no heap allocation.
+ */
+class LIB_EXPORT ChunkPipeline {
+  public:
+    ChunkPipeline(bool direction, const Botan::SecureVector<quint8> &key, quint32 threads);
+    ~ChunkPipeline();
+
+    // called from the writer with the number of plaintext bytes done so far
+    void setProgressCallback(std::function<void(qint64)> callback);
+    // polled by the writer, return true to stop the pipeline
+    void setAbortCallback(std::function<bool()> callback);
+    // stop reading after this many chunks, 0 reads up to the end of src
+    void setChunkLimit(quint64 chunks);
+    // stop reading src at this offset, -1 (default) reads up to its end.
+    // Used when more data follows the blocks, e.g. the index of an archive.
+    void setInputLimit(qint64 end);
+    // drop the first skip bytes of the output and write at most length bytes
+    // (-1 for everything), used to decrypt a byte range of a file
+    void setOutputWindow(qint64 skip, qint64 length);
+    // plaintext size of a data block, IN_BUFFER_SIZE by default
+    void setChunkSize(quint32 chunkSize);
+    // read and write through memory mappings when src and des are regular
+    // files that fit the address space, streaming is used otherwise. des
+    // must be open ReadWrite: a shared writable mapping needs a readable fd.
+    void setMemoryMapped(bool mapped);
+    // read and write regular files around the page cache, see DirectFile.
+    // A file that refuses it is streamed through the cache with
+    // posix_fadvise hints, and its pages are dropped as the run goes.
+    // Turns memory mapping off, and is ignored with a checkpoint callback
+    // (the last bytes wait in the DirectFile buffer).
+    void setDirectIo(bool direct);
+    // keep up to depth reads of src and writes of des in flight with an
+    // IoEngine, when they are regular files and the blocks have a fixed
+    // size (not compressed, not a stream). 0 (default) uses blocking calls.
+    // Memory mapping and direct I/O go first.
+    void setIoDepth(quint32 depth);
+    // bytes the run may hold in chunk buffers, staging buffers and
+    // compression scratch, PIPELINE_MEMORY_BUDGET by default, 0 for no limit
+    // but the THREADS * 4 buffers. The pool shrinks to fit, down to 2 buffers:
+    // the reader then waits for the writer (backpressure) instead of
+    // allocating more.
+    void setMemoryBudget(quint64 memory);
+    // bytes held at most by run() with the current settings
+    quint64 memoryUsage() const;
+    quint32 threads() const;
+    // the last data block is short: on encryption an empty chunk follows a
+    // full last one, on decryption a source ending on a full chunk (or with
+    // no chunk at all) was cut and the run fails. Used for streams, whose
+    // size is not in the header. Turns memory mapping off.
+    void setFinalChunk(bool finalChunk);
+    // COMPRESSION_ZLIB compresses every chunk in the workers before its
+    // encryption; a chunk that doesn't shrink is kept as is. The encrypted
+    // blocks are then preceded by their length and closed by a CHUNK_END
+    // block, so a cut file fails. Turns memory mapping off.
+    void setCompression(quint32 codec);
+    // called from the writer every interval chunks, once they are written,
+    // with the number of data blocks done since the first one of the file
+    // and the chained hash of their tags. state is the chain of the blocks
+    // before firstIndex. Turns memory mapping off. See Journal.
+    void setCheckpointCallback(std::function<void(quint64, const Botan::SecureVector<quint8> &)> callback,
+                               quint64 interval,
+                               const Botan::SecureVector<quint8> &state);
+
+    // nonce is the triple nonce stored in the file header and firstIndex the
+    // CryptoEngine chunk index of the first chunk read from src (1 for the
+    // first data block, see CryptoEngine::setChunkIndex).
+    quint32 run(QIODevice &src, QIODevice &des, const Botan::SecureVector<quint8> &nonce, quint64 firstIndex = 1);
+
+    // Chunk size policy: about CHUNKS_PER_FILE chunks per file, rounded up to
+    // a power of two between MIN_CHUNK_SIZE and MAX_CHUNK_SIZE. Small files
+    // keep fine-grained chunks, big files pay less per-chunk overhead.
+    static quint32 adaptiveChunkSize(qint64 fileSize);
+
+    // move src past chunks encrypted blocks of a compressed file, false if
+    // a length is out of bounds or src ends first
+    static bool skipChunks(QIODevice &src, quint64 chunks, quint32 chunkSize);
+
+    // state = SHA-256(state || the three tags of a block), TAG_STATE_LEN
+    // zeros before the first block
+    static void chainTags(Botan::SecureVector<quint8> &state, const quint8 *tags);
+    // chain the tags of the next chunks encrypted blocks of src, a file
+    // positioned on a data block, and move it past them
+    static bool replayTags(QIODevice &src, quint64 chunks, quint32 chunkSize, bool compressed, Botan::SecureVector<quint8> &state);
+
+    // chunk buffers of the pool allocated by the last run(): its size, plus
+    // one for every buffer that had to grow while in use. Only the pool is
+    // counted, the cipher objects of CryptoEngine allocate on their own.
+    quint64 poolBuffers() const;
+    // the last run() went through memory mappings, see setMemoryMapped
+    bool mapped() const;
+
+  private:
+    void readChunks(QIODevice &src);
+    quint64 readAsync();
+    void openAsync(QIODevice &src, QIODevice &des);
+    qint64 bufferSize() const;
+    qint64 fixedMemory() const;
+    quint32 poolSize() const;
+    void processChunks();
+    bool chunkReady(quint64 slot, quint64 next) const;
+    void waitChunk(quint64 slot, quint64 next);
+    void wakeWriter();
+    void stop();
+    void packChunk(Chunk &chunk) const;
+    bool unpackChunk(Chunk &chunk) const;
+    static qint64 readFull(QDataStream &stream, char *data, qint64 size);
+    bool mapFiles(QIODevice &src, QIODevice &des);
+    void unmapFiles(QIODevice &src, QIODevice &des, qint64 written);
+    void openDirect(QIODevice &src, QIODevice &des);
+    void dropCache(QFileDevice *file, qint64 &dropped);
+
+    bool m_direction;
+    Botan::SecureVector<quint8> m_key;
+    Botan::SecureVector<quint8> m_nonce;
+    quint64 m_firstIndex = 1;
+    quint64 m_chunkLimit = 0;
+    qint64 m_inputLimit  = -1;
+    qint64 m_inputLeft   = -1; // bytes of src the reader may still read, see setInputLimit
+    qint64 m_skip        = 0;
+    qint64 m_length      = -1;
+    quint32 m_chunkSize  = consts::IN_BUFFER_SIZE;
+    bool m_memoryMapped  = false;
+    bool m_directIo      = false;
+    quint32 m_ioDepth    = 0;
+    bool m_finalChunk    = false;
+    quint32 m_compression = consts::COMPRESSION_NONE;
+    quint64 m_memoryBudget = consts::PIPELINE_MEMORY_BUDGET;
+    bool m_truncated     = false; // set by the reader, see setFinalChunk
+    quint32 m_threads;
+    quint32 m_maxInFlight;
+
+    std::function<void(qint64)> m_progress;
+    std::function<bool()> m_aborted;
+    std::function<void(quint64, const Botan::SecureVector<quint8> &)> m_checkpoint;
+    quint64 m_checkpointInterval = 0;
+    Botan::SecureVector<quint8> m_tagState;
+
+    // a slot holds a chunk once its flag is set by the worker, until the
+    // writer clears it
+    struct alignas(RING_CACHE_LINE) ReadyFlag {
+        std::atomic<bool> ready{false};
+    };
+
+    // m_free holds the buffer pool (given back by the writer only, taken by
+    // the reader only), m_slots the chunks waiting for the writer (chunk i in
+    // slot i % m_maxInFlight). The mutex is only taken by the writer to
+    // sleep, and by the other threads to wake it when it sleeps.
+    ChunkQueue<Botan::SecureVector<quint8>, SpscRing<Botan::SecureVector<quint8>>> m_free;
+    ChunkQueue<Chunk> m_work;
+    std::vector<Chunk> m_slots;
+    std::vector<ReadyFlag> m_ready;
+    std::mutex m_doneMutex;
+    std::condition_variable m_doneCond;
+    std::atomic<int> m_writerWaiting{0};
+    std::atomic<quint64> m_poolBuffers{0};
+    std::atomic<quint64> m_chunkCount{0};
+    std::atomic<bool> m_readerFinished{false};
+    std::atomic<bool> m_failed{false};
+    std::atomic<bool> m_stop{false};
+
+    bool m_mapped       = false;
+    uchar *m_input      = nullptr;
+    qint64 m_inputSize  = 0;
+    uchar *m_output     = nullptr;
+    qint64 m_outputSize = 0;
+    qint64 m_outputBase = 0;
+
+    // the direct I/O devices of the run, or the files streamed through the
+    // cache whose pages are dropped
+    std::unique_ptr<DirectFile> m_directInput;
+    std::unique_ptr<DirectFile> m_directOutput;
+    QFileDevice *m_cachedInput  = nullptr;
+    QFileDevice *m_cachedOutput = nullptr;
+
+    // the file descriptors of an asynchronous run, see setIoDepth
+    int m_inputFd      = -1;
+    qint64 m_inputBase = 0;
+    qint64 m_inputEnd  = 0;
+    int m_outputFd     = -1;
+    bool m_readFailed  = false; // set by the reader
+
+    std::thread m_reader;
+    std::vector<std::thread> m_workers;
+
+    const std::unique_ptr<consts> m_const;
+};
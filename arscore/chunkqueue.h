@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "ringqueue.h"
+
+// Bounded blocking FIFO used to hand chunks between the stages of the
+// ChunkPipeline. push() blocks while the queue is full, pop() blocks while
+// it is empty, tryPop() fails instead. Once close() is called, push() fails
+// and pop() drains what is left before failing too.
+//
+// The items go through a lock-free Ring (MpmcRing, or SpscRing when a single
+// thread pushes and a single one pops), allocated once. The mutex is only
+// taken to sleep when a push or a pop still fails after a short spin, and to
+// wake a thread that sleeps: a busy queue never takes it.
+template <typename T, typename Ring = MpmcRing<T>>
+class ChunkQueue {
+  public:
+    explicit ChunkQueue(size_t capacity)
+        : m_ring(capacity)
+    {
+    }
+
+    bool push(T &&item)
+    {
+        if (m_closed.load(std::memory_order_acquire))
+            return (false);
+        if (!spin([&] { return m_ring.tryPush(std::move(item)); })) {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            auto pushed = false;
+            sleep(lock, m_notFull, m_pushWaiters, [&] { return m_closed || (pushed = m_ring.tryPush(std::move(item))); });
+            if (!pushed)
+                return (false);
+        }
+        wake(m_notEmpty, m_popWaiters);
+        return (true);
+    }
+
+    bool pop(T &item)
+    {
+        if (!spin([&] { return m_ring.tryPop(item); })) {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            auto popped = false;
+            sleep(lock, m_notEmpty, m_popWaiters, [&] { return (popped = m_ring.tryPop(item)) || m_closed; });
+            // pushed before close(), but after the last look
+            if (!popped && !m_ring.tryPop(item))
+                return (false);
+        }
+        wake(m_notFull, m_pushWaiters);
+        return (true);
+    }
+
+    bool tryPop(T &item)
+    {
+        if (!m_ring.tryPop(item))
+            return (false);
+        wake(m_notFull, m_pushWaiters);
+        return (true);
+    }
+
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_notFull.notify_all();
+        m_notEmpty.notify_all();
+    }
+
+  private:
+    // a few tries before sleeping, the other side is often about to be done
+    template <typename Try>
+    static bool spin(Try attempt)
+    {
+        for (int i = 0; i < 64; ++i) {
+            if (attempt())
+                return (true);
+            if (i >= 16)
+                std::this_thread::yield();
+        }
+        return (false);
+    }
+
+    // the waiter is counted before its last try, and wake() looks at the
+    // count after its push or pop: one of them sees the other
+    template <typename Ready>
+    static void sleep(std::unique_lock<std::mutex> &lock, std::condition_variable &cond, std::atomic<int> &waiters, Ready ready)
+    {
+        waiters.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        cond.wait(lock, ready);
+        waiters.fetch_sub(1);
+    }
+
+    void wake(std::condition_variable &cond, std::atomic<int> &waiters)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_relaxed) == 0)
+            return;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        cond.notify_one();
+    }
+
+    Ring m_ring;
+    std::atomic<bool> m_closed{false};
+    std::atomic<int> m_pushWaiters{0};
+    std::atomic<int> m_popWaiters{0};
+    std::mutex m_mutex;
+    std::condition_variable m_notFull;
+    std::condition_variable m_notEmpty;
+};
@@ -18,7 +18,7 @@ class LIB_EXPORT consts : public QObject {
     explicit consts(QObject *parent = nullptr);
 
     static inline int const EXIT_CODE_REBOOT = -123456789;
-    static inline QVersionNumber const APP_VERSION{4, 0, 0};
+    static inline QVersionNumber const APP_VERSION{4, 7, 0};
     static inline QString const APP_SHORT_NAME         = "Arsenic";
     static inline QString const APP_LONG_NAME          = "Arsenic " + APP_VERSION.toString();
     static inline QString const APP_DESCRIPTION        = "Arsenic - Strong encryption";
@@ -41,6 +41,17 @@ class LIB_EXPORT consts : public QObject {
     static inline quint32 const CIPHER_KEY_LEN = 32;
     static inline quint32 const CIPHER_IV_LEN  = 24;
 
+    // Size of the encrypted data blocks, stored in the header since 4.1.0.
+    // Older files always use IN_BUFFER_SIZE.
+    static inline QVersionNumber const CHUNK_SIZE_VERSION{4, 1, 0};
+    static inline quint32 const MIN_CHUNK_SIZE  = 65536;   // 64 KiB
+    static inline quint32 const MAX_CHUNK_SIZE  = 8388608; // 8 MiB
+    static inline quint32 const CHUNKS_PER_FILE = 1024;    // target of the adaptive chunk size
+
+    // Sub-block size of the fused cascade in CryptoEngine::finish. Must be a
+    // multiple of 64, the largest update granularity of the three modes.
+    static inline quint32 const CASCADE_BLOCK_SIZE = 16384;
+
     // Argon2 constants
     static inline quint32 const ARGON_SALT_LEN       = 16;
     static inline quint32 const MEMLIMIT_INTERACTIVE = 65536;  // 64mb
@@ -51,7 +62,91 @@ class LIB_EXPORT consts : public QObject {
     static inline quint32 const ITERATION_MODERATE    = 2;
     static inline quint32 const ITERATION_SENSITIVE   = 3;
 
-    static inline quint32 const PARALLELISM_INTERACTIVE = 1; // For now, Argon2 in Botan don't use Parallelism > 1
+    // Argon2 lanes. Stored in the header since 4.2.0, older files use 1.
+    // More than one lane is derived by Argon2id, which fills them in parallel.
+    static inline QVersionNumber const LANES_VERSION{4, 2, 0};
+    static inline quint32 const PARALLELISM_INTERACTIVE = 1;
+    static inline quint32 const PARALLELISM_DEFAULT     = 4;
+    static inline quint32 const PARALLELISM_MAX         = 64;
+
+    // How the key of a file is derived, stored in the header since 4.3.0.
+    // KEY_MODE_PASSWORD: the key is Argon2(passphrase, salt).
+    // KEY_MODE_MASTER: Argon2(passphrase, salt) is the master key of a batch,
+    // shared by every file of the job, and the key is HKDF(master key, file salt).
+    static inline QVersionNumber const KEY_MODE_VERSION{4, 3, 0};
+    static inline quint32 const KEY_MODE_PASSWORD = 0;
+    static inline quint32 const KEY_MODE_MASTER   = 1;
+    static inline quint32 const FILE_SALT_LEN     = 16;
+
+    // Archives (see ArchiveStream), since 4.4.0: many files in one encrypted
+    // stream. The header of a file with ARCHIVE_MAGIC_NUMBER and no name
+    // block, the data of every member, the encrypted index and its size.
+    static inline QVersionNumber const ARCHIVE_VERSION{4, 4, 0};
+    static inline quint32 const ARCHIVE_MAGIC_NUMBER = 0x41525341; // "ARSA"
+
+    // Encrypted name block, since 4.5.0: the name length (NAME_LENGTH_LEN
+    // bytes), the name and zeros up to a multiple of the padding bucket. The
+    // header stores the size of the block, so only the bucket shows. Before,
+    // the name was followed by IN_BUFFER_SIZE random bytes and the header
+    // stored its length.
+    static inline QVersionNumber const NAME_BLOCK_VERSION{4, 5, 0};
+    static inline quint32 const NAME_LENGTH_LEN  = 2;
+    static inline quint32 const NAME_PADDING     = 256;   // every name up to 254 bytes gives the same block
+    static inline quint32 const NAME_PADDING_MAX = 65536; // also the largest name block read
+
+    // Streams, since 4.6.0: encrypted from a pipe, without a name and with
+    // STREAM_FILE_SIZE as size. The last data block is always short, an
+    // empty one follows a full last chunk, so a cut stream is detected.
+    static inline QVersionNumber const STREAM_VERSION{4, 6, 0};
+    static inline qint64 const STREAM_FILE_SIZE   = -1;
+    static inline quint32 const STREAM_CHUNK_SIZE = 1048576; // 1 MiB, the size is unknown
+
+    // Compression of the data blocks, stored in the header since 4.7.0 (see
+    // ChunkPipeline::setCompression). A compressed file has no fixed block
+    // size: every encrypted block is preceded by its length, its plaintext
+    // starts with a CHUNK_* flag and a CHUNK_END block closes the data.
+    static inline QVersionNumber const COMPRESSION_VERSION{4, 7, 0};
+    static inline quint32 const COMPRESSION_NONE  = 0;
+    static inline quint32 const COMPRESSION_ZLIB  = 1; // the zlib bundled with QtCore
+    static inline int const COMPRESSION_LEVEL     = 1; // fastest, the cascade runs at a few hundred MB/s
+    static inline quint32 const CHUNK_LENGTH_LEN  = 4;
+    static inline quint8 const CHUNK_RAW          = 0; // did not compress, stored as is
+    static inline quint8 const CHUNK_ZLIB         = 1;
+    static inline quint8 const CHUNK_END          = 2;
+
+    // Resumable jobs (see Journal)
+    static inline QString const JOURNAL_EXTENSION = ".journal";
+    static inline quint32 const JOURNAL_MAGIC     = 0x4152534A; // "ARSJ"
+    static inline qint64 const JOURNAL_INTERVAL   = 67108864;   // 64 MiB between two checkpoints
+    static inline quint32 const TAG_STATE_LEN     = 32;         // SHA-256
+
+    // Direct I/O (see DirectFile)
+    static inline qint64 const DIRECT_IO_ALIGN         = 4096;     // logical block size of most disks, and a page
+    static inline qint64 const DIRECT_IO_BUFFER        = 1048576;  // 1 MiB read or written at once
+    static inline qint64 const DIRECT_IO_DROP_INTERVAL = 16777216; // 16 MiB between two posix_fadvise, through the cache
+
+    // Asynchronous file I/O (see IoEngine)
+    static inline quint32 const IO_DEPTH_MAX   = 256; // requests in flight at most
+    static inline quint32 const IO_THREADS_MAX = 8;   // blocking threads when io_uring is not there
+
+    // Header inspection (see Inspection), mostly waiting on the disk
+    static inline quint32 const INSPECT_THREADS = 16;
+
+    // Job scheduling (see JobScheduler and KeyCache)
+    static inline qint64 const LARGE_FILE_SIZE         = 16777216;  // 16 MiB, from there a file gets every chunk worker
+    static inline int const SMALL_FILE_BATCH           = 64;        // most small files handed to a worker at once
+    static inline quint64 const ARGON_MEMORY_BUDGET    = 2097152;   // 2gb of Argon2 memory in use at once
+    static inline quint32 const KEY_CACHE_SIZE         = 16;        // derived keys kept between the jobs of a session
+    static inline quint64 const PIPELINE_MEMORY_BUDGET = 536870912; // 512 MiB of chunk buffers for the files of a job
+
+    // Directory walking (see DirectoryWalker)
+    static inline quint32 const WALKER_THREADS    = 4;
+    static inline quint32 const WALKER_QUEUE_SIZE = 4096; // paths found ahead of the workers
+
+    // Argon2 calibration (see ArgonCalibration)
+    static inline quint32 const CALIBRATION_TARGET_MS     = 500;
+    static inline quint32 const MEMLIMIT_CALIBRATION_MAX  = 4194304; // 4gb
+    static inline quint32 const ITERATION_CALIBRATION_MAX = 16;
 
   signals:
 };
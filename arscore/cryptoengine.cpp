@@ -1,6 +1,9 @@
 #include "cryptoengine.h"
+#include <algorithm>
 #include <cassert>
 
+#include "argon2id.h"
+
 using namespace Botan;
 
 CryptoEngine::CryptoEngine(bool direction, QObject *parent)
@@ -25,17 +28,32 @@ void CryptoEngine::setSalt(const Botan::OctetString &salt)
     m_salt = salt;
 }
 
-void CryptoEngine::derivePassword(const QString &password, quint32 memlimit, quint32 iterations)
+void CryptoEngine::derivePassword(const QString &password, quint32 memlimit, quint32 iterations, quint32 parallelism)
 {
     const auto pass{password.toStdString()};
     SecureVector<char> pass_buffer(pass.begin(), pass.end());
 
-    auto pwdhash_fam{PasswordHashFamily::create("Argon2id")};
-
     SecureVector<quint8> key_buffer(m_const->CIPHER_KEY_LEN * 3);
 
+    if (parallelism > 1) {
+        // Botan fills the lanes one after the other, Argon2id uses a thread per lane
+        Argon2id::derive(key_buffer.data(),
+                         key_buffer.size(),
+                         pass_buffer.data(),
+                         pass_buffer.size(),
+                         m_salt.bits_of().data(),
+                         m_salt.size(),
+                         memlimit,
+                         iterations,
+                         parallelism);
+        setKey(key_buffer);
+        return;
+    }
+
+    auto pwdhash_fam{PasswordHashFamily::create("Argon2id")};
+
     // mem,ops,threads
-    const auto default_pwhash{pwdhash_fam->from_params(memlimit, iterations, m_const->PARALLELISM_INTERACTIVE)};
+    const auto default_pwhash{pwdhash_fam->from_params(memlimit, iterations, parallelism)};
 
     default_pwhash->derive_key(key_buffer.data(),
                                key_buffer.size(),
@@ -44,7 +62,31 @@ void CryptoEngine::derivePassword(const QString &password, quint32 memlimit, qui
                                m_salt.bits_of().data(),
                                m_salt.size());
 
-    const auto *mk{key_buffer.begin().base()};
+    setKey(key_buffer);
+}
+
+void CryptoEngine::deriveFileKey(const SecureVector<quint8> &masterKey, const SecureVector<quint8> &fileSalt)
+{
+    const auto hkdf = KDF::create_or_throw("HKDF(SHA-512)");
+    const std::string label{"Arsenic file key"};
+
+    setKey(hkdf->derive_key(m_const->CIPHER_KEY_LEN * 3,
+                            masterKey.data(),
+                            masterKey.size(),
+                            fileSalt.data(),
+                            fileSalt.size(),
+                            reinterpret_cast<const quint8 *>(label.data()),
+                            label.size()));
+}
+
+void CryptoEngine::setKey(const SecureVector<quint8> &key)
+{
+    assert(key.size() == m_const->CIPHER_KEY_LEN * 3 && "Triple key must be 32*3 bytes.");
+    // keep the derived key so other engines (crypto workers) can share it
+    // without running Argon2 again
+    m_key = key;
+
+    const auto *mk{m_key.begin().base()};
     const SymmetricKey ChaCha20_key(mk, m_const->CIPHER_KEY_LEN);
     const SymmetricKey AES_key(&mk[m_const->CIPHER_KEY_LEN], m_const->CIPHER_KEY_LEN);
     const SymmetricKey Serpent_key(&mk[m_const->CIPHER_KEY_LEN + m_const->CIPHER_KEY_LEN], m_const->CIPHER_KEY_LEN);
@@ -54,9 +96,41 @@ void CryptoEngine::derivePassword(const QString &password, quint32 memlimit, qui
     m_engineSerpent->set_key(Serpent_key);
 }
 
+const SecureVector<quint8> &CryptoEngine::key() const
+{
+    return (m_key);
+}
+
 void CryptoEngine::setNonce(const SecureVector<quint8> &nonce)
 {
     assert(nonce.size() == m_const->CIPHER_IV_LEN * 3 && "Triple nonce must be 24*3 bytes.");
+    m_nonce      = nonce;
+    m_chunkIndex = 0;
+    loadNonce(nonce);
+}
+
+void CryptoEngine::setChunkIndex(quint64 index)
+{
+    assert(!m_nonce.empty() && "setNonce must be called first.");
+    m_chunkIndex = index;
+
+    // in place, so seeking does not allocate
+    const auto *n{m_nonce.data()};
+    std::copy(n, n + m_const->CIPHER_IV_LEN, m_nonceChaCha20.begin());
+    std::copy(n + m_const->CIPHER_IV_LEN, n + m_const->CIPHER_IV_LEN * 2, m_nonceAes.begin());
+    std::copy(n + m_const->CIPHER_IV_LEN * 2, n + m_const->CIPHER_IV_LEN * 3, m_nonceSerpent.begin());
+    addToNonce(m_nonceChaCha20.data(), index);
+    addToNonce(m_nonceAes.data(), index);
+    addToNonce(m_nonceSerpent.data(), index);
+}
+
+quint64 CryptoEngine::chunkIndex() const
+{
+    return (m_chunkIndex);
+}
+
+void CryptoEngine::loadNonce(const SecureVector<quint8> &nonce)
+{
     // split the triple nonce
     const auto *n{nonce.begin().base()};
     const InitializationVector iv1(n, m_const->CIPHER_IV_LEN);
@@ -68,37 +142,71 @@ void CryptoEngine::setNonce(const SecureVector<quint8> &nonce)
     m_nonceSerpent  = iv3.bits_of();
 }
 
+void CryptoEngine::addToNonce(quint8 *nonce, quint64 offset)
+{
+    // Same result as calling Sodium::sodium_increment offset times: a 24
+    // bytes nonce is a little-endian counter.
+    quint64 carry = offset;
+    for (quint32 i = 0; i < consts::CIPHER_IV_LEN && carry != 0; ++i) {
+        const quint32 sum = nonce[i] + static_cast<quint32>(carry & 0xff);
+        nonce[i]          = static_cast<quint8>(sum);
+        carry             = (carry >> 8) + (sum >> 8);
+    }
+}
+
 void CryptoEngine::incrementNonce()
 {
 
     Sodium::sodium_increment(m_nonceChaCha20.data(), m_const->CIPHER_IV_LEN);
     Sodium::sodium_increment(m_nonceAes.data(), m_const->CIPHER_IV_LEN);
     Sodium::sodium_increment(m_nonceSerpent.data(), m_const->CIPHER_IV_LEN);
+    ++m_chunkIndex;
 }
 
 void CryptoEngine::finish(SecureVector<quint8> &buffer)
 {
+    /* Fused cascade: instead of three passes over the whole buffer, every
+     * CASCADE_BLOCK_SIZE sub-block goes through the three layers while it is
+     * still in cache. Each layer sees exactly the same byte stream as with
+     * three separate finish() calls, so ciphertext and tags are unchanged:
+     * the tail of the buffer (and the tags that the inner layers append) is
+     * handled by the finish() of each layer.
+     */
+    const auto block = m_const->CASCADE_BLOCK_SIZE;
+    size_t pos       = 0;
 
     if (m_direction == ENCRYPTION) {
         incrementNonce();
         m_engineChacha->start(m_nonceChaCha20);
-        m_engineChacha->finish(buffer);
-
         m_engineAes->start(m_nonceAes);
-        m_engineAes->finish(buffer);
-
         m_engineSerpent->start(m_nonceSerpent);
-        m_engineSerpent->finish(buffer);
+
+        for (; pos + block < buffer.size(); pos += block) {
+            m_engineChacha->process(buffer.data() + pos, block);
+            m_engineAes->process(buffer.data() + pos, block);
+            m_engineSerpent->process(buffer.data() + pos, block);
+        }
+
+        m_engineChacha->finish(buffer, pos);
+        m_engineAes->finish(buffer, pos);
+        m_engineSerpent->finish(buffer, pos);
     }
     else {
         incrementNonce();
         m_engineSerpent->start(m_nonceSerpent);
-        m_engineSerpent->finish(buffer);
-
         m_engineAes->start(m_nonceAes);
-        m_engineAes->finish(buffer);
-
         m_engineChacha->start(m_nonceChaCha20);
-        m_engineChacha->finish(buffer);
+
+        // the last 3 tags are not data for the innermost layer
+        const auto tags = m_const->MACBYTES * 3;
+        for (; pos + block + tags < buffer.size(); pos += block) {
+            m_engineSerpent->process(buffer.data() + pos, block);
+            m_engineAes->process(buffer.data() + pos, block);
+            m_engineChacha->process(buffer.data() + pos, block);
+        }
+
+        m_engineSerpent->finish(buffer, pos);
+        m_engineAes->finish(buffer, pos);
+        m_engineChacha->finish(buffer, pos);
     }
 }
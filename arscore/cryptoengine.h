@@ -12,13 +12,32 @@ class CryptoEngine : public QObject {
     explicit CryptoEngine(bool direction = true, QObject *parent = nullptr);
 
     void setSalt(const Botan::OctetString &salt);
-    void derivePassword(const QString &password, quint32 memlimit, quint32 iterations);
+    void derivePassword(const QString &password,
+                        quint32 memlimit,
+                        quint32 iterations,
+                        quint32 parallelism = consts::PARALLELISM_INTERACTIVE);
+    // key of one file of a batch: HKDF-SHA-512 of the batch master key
+    // (the derivePassword() output) with a per-file salt
+    void deriveFileKey(const Botan::SecureVector<quint8> &masterKey, const Botan::SecureVector<quint8> &fileSalt);
+    void setKey(const Botan::SecureVector<quint8> &key);
+    const Botan::SecureVector<quint8> &key() const;
     void setNonce(const Botan::SecureVector<quint8> &nonce);
+
+    // Chunk N is the (N+1)th finish() call after setNonce(): 0 is the
+    // encrypted header of an .arsn file and data block k is k + 1.
+    // setChunkIndex() jumps to any chunk in O(1).
+    void setChunkIndex(quint64 index);
+    quint64 chunkIndex() const;
+
     void finish(Botan::SecureVector<quint8> &buffer);
 
   private:
+    static void addToNonce(quint8 *nonce, quint64 offset);
+    void loadNonce(const Botan::SecureVector<quint8> &nonce);
     void incrementNonce();
     Botan::Cipher_Dir m_direction;
+    Botan::SecureVector<quint8> m_nonce;
+    quint64 m_chunkIndex = 0;
     Botan::SecureVector<quint8> m_nonceChaCha20;
     Botan::SecureVector<quint8> m_nonceAes;
     Botan::SecureVector<quint8> m_nonceSerpent;
@@ -28,6 +47,7 @@ class CryptoEngine : public QObject {
     std::unique_ptr<Botan::AEAD_Mode> m_engineSerpent;
 
     Botan::OctetString m_salt;
+    Botan::SecureVector<quint8> m_key;
 
     const std::unique_ptr<consts> m_const;
 
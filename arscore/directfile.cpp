@@ -0,0 +1,257 @@
+#include "directfile.h"
+
+#include <QFile>
+#include <cstring>
+
+#include "botan_all.h"
+#include "consts.h"
+
+#if defined(Q_OS_UNIX)
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+qint64 alignDown(qint64 offset)
+{
+    return (offset - offset % consts::DIRECT_IO_ALIGN);
+}
+
+qint64 alignUp(qint64 size)
+{
+    return (alignDown(size + consts::DIRECT_IO_ALIGN - 1));
+}
+} // namespace
+
+DirectFile::DirectFile(const QString &fileName, qint64 offset)
+    : m_fileName(fileName),
+      m_start(offset)
+{
+}
+
+DirectFile::~DirectFile()
+{
+    close();
+}
+
+bool DirectFile::open(OpenMode mode)
+{
+#if defined(Q_OS_UNIX)
+    m_write         = (mode & QIODevice::WriteOnly) != 0;
+    const auto path = QFile::encodeName(m_fileName);
+#if defined(O_DIRECT)
+    m_fd = ::open(path.constData(), (m_write ? O_RDWR : O_RDONLY) | O_DIRECT);
+#elif defined(F_NOCACHE)
+    m_fd = ::open(path.constData(), m_write ? O_RDWR : O_RDONLY);
+    if (m_fd >= 0 && fcntl(m_fd, F_NOCACHE, 1) != 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+#endif
+    if (m_fd < 0)
+        return (false);
+
+    void *buffer = nullptr;
+    if (posix_memalign(&buffer, consts::DIRECT_IO_ALIGN, consts::DIRECT_IO_BUFFER) != 0) {
+        ::close(m_fd);
+        m_fd = -1;
+        return (false);
+    }
+    m_buffer = static_cast<quint8 *>(buffer);
+    m_locked = mlock(m_buffer, consts::DIRECT_IO_BUFFER) == 0;
+
+    // the first block, or the bytes before offset in it to write them back
+    m_blockStart = alignDown(m_start);
+    m_begin      = m_start - m_blockStart;
+    m_end        = 0;
+    m_eof        = false;
+    m_failed     = false;
+    const auto read = transfer(false, m_write ? consts::DIRECT_IO_ALIGN : consts::DIRECT_IO_BUFFER);
+    if (read < 0 || (m_write && read < m_begin)) {
+        m_failed = true;
+        close();
+        return (false);
+    }
+
+    if (m_write) {
+        m_end   = m_begin;
+        m_begin = 0;
+    }
+    else {
+        m_end = read;
+        m_eof = read < consts::DIRECT_IO_BUFFER;
+    }
+    return (QIODevice::open(mode | QIODevice::Unbuffered));
+#else
+    Q_UNUSED(mode);
+    return (false);
+#endif
+}
+
+void DirectFile::close()
+{
+#if defined(Q_OS_UNIX)
+    if (m_fd >= 0) {
+        if (m_write && isOpen() && !m_failed) {
+            // pad the last block, the file is cut back to its size
+            const auto padded = alignUp(m_end);
+            memset(m_buffer + m_end, 0, padded - m_end);
+            if (m_end > 0 && !flushBuffer(padded))
+                m_failed = true;
+            if (ftruncate(m_fd, m_blockStart + m_end) != 0)
+                m_failed = true;
+        }
+        ::close(m_fd);
+        m_fd = -1;
+    }
+
+    // the buffer held plaintext
+    if (m_buffer) {
+        Botan::secure_scrub_memory(m_buffer, consts::DIRECT_IO_BUFFER);
+        if (m_locked)
+            munlock(m_buffer, consts::DIRECT_IO_BUFFER);
+        free(m_buffer);
+        m_buffer = nullptr;
+        m_locked = false;
+    }
+#endif
+    QIODevice::close();
+}
+
+bool DirectFile::isSequential() const
+{
+    return (true);
+}
+
+qint64 DirectFile::position() const
+{
+    return (m_blockStart + (m_write ? m_end : m_begin));
+}
+
+bool DirectFile::failed() const
+{
+    return (m_failed);
+}
+
+void DirectFile::adviseSequential(QFileDevice &file)
+{
+#if defined(POSIX_FADV_SEQUENTIAL)
+    posix_fadvise(file.handle(), 0, 0, POSIX_FADV_SEQUENTIAL);
+#else
+    Q_UNUSED(file);
+#endif
+}
+
+void DirectFile::dropCache(QFileDevice &file, qint64 offset, qint64 length)
+{
+#if defined(POSIX_FADV_DONTNEED)
+    // dirty pages are not dropped, write them back first
+    if (file.openMode() & QIODevice::WriteOnly) {
+        file.flush();
+#if defined(Q_OS_LINUX)
+        sync_file_range(file.handle(), offset, length, SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+#else
+        fdatasync(file.handle());
+#endif
+    }
+    posix_fadvise(file.handle(), offset, length, POSIX_FADV_DONTNEED);
+#else
+    Q_UNUSED(file);
+    Q_UNUSED(offset);
+    Q_UNUSED(length);
+#endif
+}
+
+qint64 DirectFile::readData(char *data, qint64 maxSize)
+{
+    qint64 done = 0;
+    while (done < maxSize) {
+        if (m_begin >= m_end) {
+            if (m_eof)
+                break;
+            m_blockStart += m_end;
+            m_begin = 0;
+            if (!fill())
+                return (done > 0 ? done : -1);
+            continue;
+        }
+
+        const auto bytes = qMin(maxSize - done, m_end - m_begin);
+        memcpy(data + done, m_buffer + m_begin, bytes);
+        m_begin += bytes;
+        done += bytes;
+    }
+    return (done);
+}
+
+qint64 DirectFile::writeData(const char *data, qint64 size)
+{
+    qint64 done = 0;
+    while (done < size) {
+        const auto bytes = qMin<qint64>(size - done, consts::DIRECT_IO_BUFFER - m_end);
+        memcpy(m_buffer + m_end, data + done, bytes);
+        m_end += bytes;
+        done += bytes;
+
+        if (m_end == consts::DIRECT_IO_BUFFER) {
+            if (!flushBuffer(m_end)) {
+                m_failed = true;
+                return (-1);
+            }
+            m_blockStart += m_end;
+            m_end = 0;
+        }
+    }
+    return (done);
+}
+
+bool DirectFile::fill()
+{
+    const auto bytes = transfer(false, consts::DIRECT_IO_BUFFER);
+    if (bytes < 0) {
+        m_failed = true;
+        return (false);
+    }
+    m_end = bytes;
+    m_eof = bytes < consts::DIRECT_IO_BUFFER;
+    return (true);
+}
+
+bool DirectFile::flushBuffer(qint64 size)
+{
+    return (transfer(true, size) == size);
+}
+
+qint64 DirectFile::transfer(bool write, qint64 size)
+{
+#if defined(Q_OS_UNIX)
+    qint64 done = 0;
+    while (done < size) {
+        const auto offset = m_blockStart + done;
+        const auto bytes  = write ? pwrite(m_fd, m_buffer + done, size - done, offset) : pread(m_fd, m_buffer + done, size - done, offset);
+        if (bytes < 0 && errno == EINTR)
+            continue;
+#if defined(O_DIRECT)
+        // the file system wants another alignment: go through the cache
+        if (bytes < 0 && errno == EINVAL) {
+            const auto flags = fcntl(m_fd, F_GETFL);
+            if (flags >= 0 && (flags & O_DIRECT) && fcntl(m_fd, F_SETFL, flags & ~O_DIRECT) == 0)
+                continue;
+        }
+#endif
+        if (bytes < 0)
+            return (-1);
+        if (bytes == 0)
+            break;
+        done += bytes;
+    }
+    return (done);
+#else
+    Q_UNUSED(write);
+    Q_UNUSED(size);
+    return (-1);
+#endif
+}
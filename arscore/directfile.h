@@ -0,0 +1,64 @@
+#pragma once
+
+#include <QFileDevice>
+#include <QIODevice>
+#include <QString>
+
+#include "libexport.h"
+
+/* Sequential reads or writes of a regular file that bypass the page cache
+ * (O_DIRECT on Linux, F_NOCACHE on macOS), so a huge bulk job doesn't evict
+ * the working set of the other programs of the host.
+ *
+ * The file is read or written from offset through one page-aligned buffer
+ * of DIRECT_IO_BUFFER bytes, locked in memory when the system allows it and
+ * wiped when it is freed. Only whole DIRECT_IO_ALIGN blocks go to the disk:
+ * on writing, the block holding offset is read back first and the last one
+ * is padded, then the file is cut to its size on close(). If the file system
+ * rejects an aligned access (EINVAL), the cache is used for the rest of the
+ * file, the data is never lost.
+ */
+class LIB_EXPORT DirectFile : public QIODevice {
+  public:
+    DirectFile(const QString &fileName, qint64 offset);
+    ~DirectFile() override;
+
+    // ReadOnly or WriteOnly, the file must exist. false if it can't be opened
+    // without the cache: use a QFile with the hints below instead.
+    bool open(OpenMode mode) override;
+    // write the last block and cut the file to its size
+    void close() override;
+    bool isSequential() const override;
+
+    // offset in the file after the last byte read or written
+    qint64 position() const;
+    // false if an access failed, see close()
+    bool failed() const;
+
+    // hints for a file read or written through the cache: it is read once,
+    // from start to end
+    static void adviseSequential(QFileDevice &file);
+    // write back and drop the cached pages of this range, done with
+    static void dropCache(QFileDevice &file, qint64 offset, qint64 length);
+
+  protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 size) override;
+
+  private:
+    bool fill();
+    bool flushBuffer(qint64 size);
+    qint64 transfer(bool write, qint64 size);
+
+    QString m_fileName;
+    qint64 m_start      = 0;
+    qint64 m_blockStart = 0; // offset of the first byte of m_buffer, aligned
+    qint64 m_begin      = 0; // first byte of m_buffer not read yet
+    qint64 m_end        = 0; // bytes of m_buffer read from or to be written to the file
+    bool m_write        = false;
+    bool m_eof          = false;
+    bool m_failed       = false;
+    int m_fd            = -1;
+    quint8 *m_buffer    = nullptr;
+    bool m_locked       = false;
+};
@@ -0,0 +1,119 @@
+#include "directorywalker.h"
+
+#include <QDir>
+#include <QDirIterator>
+
+#include "consts.h"
+
+using namespace std;
+
+DirectoryWalker::DirectoryWalker(quint32 threads)
+    : m_threads(threads > 0 ? threads : consts::WALKER_THREADS)
+{
+}
+
+DirectoryWalker::~DirectoryWalker()
+{
+    wait();
+}
+
+void DirectoryWalker::setFilter(function<bool(const QFileInfo &)> filter)
+{
+    m_filter = move(filter);
+}
+
+void DirectoryWalker::start(const QStringList &roots, ChunkQueue<QString> &files)
+{
+    wait();
+
+    {
+        lock_guard<mutex> lock(m_mutex);
+        // taken from the back, so the roots go in the order of the list
+        m_pending.assign(roots.rbegin(), roots.rend());
+        m_busy        = 0;
+        m_running     = m_threads;
+        m_stopped     = false;
+        m_directories = 0;
+    }
+
+    for (quint32 i = 0; i < m_threads; ++i)
+        m_pool.emplace_back([this, &files] { work(files); });
+}
+
+void DirectoryWalker::wait()
+{
+    for (auto &walker : m_pool)
+        walker.join();
+    m_pool.clear();
+}
+
+quint64 DirectoryWalker::directories() const
+{
+    lock_guard<mutex> lock(m_mutex);
+    return (m_directories);
+}
+
+bool DirectoryWalker::hasDirectory(const QStringList &paths)
+{
+    for (const auto &path : paths) {
+        if (QFileInfo(path).isDir())
+            return (true);
+    }
+    return (false);
+}
+
+void DirectoryWalker::work(ChunkQueue<QString> &files)
+{
+    for (;;) {
+        QString path;
+        {
+            unique_lock<mutex> lock(m_mutex);
+            m_changed.wait(lock, [this] { return m_stopped || !m_pending.empty() || m_busy == 0; });
+
+            // nothing left to list and nobody listing: the walk is over
+            if (m_stopped || m_pending.empty()) {
+                if (--m_running == 0)
+                    files.close();
+                m_changed.notify_all();
+                return;
+            }
+
+            // depth first, only the siblings of the current path wait here
+            path = m_pending.back();
+            m_pending.pop_back();
+            ++m_busy;
+        }
+
+        QStringList subdirectories;
+        const auto directory = QFileInfo(path).isDir();
+        auto open            = true;
+
+        if (directory) {
+            // entries are read as they come, a huge directory is never loaded at once
+            QDirIterator it(path, QDir::Dirs | QDir::Files | QDir::NoSymLinks | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System);
+            while (open && it.hasNext()) {
+                it.next();
+                const auto entry = it.fileInfo();
+
+                if (entry.isDir())
+                    subdirectories.append(entry.filePath());
+                else if (entry.isFile() && (!m_filter || m_filter(entry)))
+                    open = files.push(entry.filePath());
+            }
+        }
+        else {
+            // a file given as a root, missing files are reported by the job
+            open = files.push(QString(path));
+        }
+
+        lock_guard<mutex> lock(m_mutex);
+        if (!open)
+            m_stopped = true;
+        if (directory)
+            ++m_directories;
+        for (auto it = subdirectories.rbegin(); it != subdirectories.rend(); ++it)
+            m_pending.push_back(*it);
+        --m_busy;
+        m_changed.notify_all();
+    }
+}
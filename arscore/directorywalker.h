@@ -0,0 +1,63 @@
+#pragma once
+
+#include <QFileInfo>
+#include <QString>
+#include <QStringList>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "chunkqueue.h"
+#include "libexport.h"
+
+/* Walk directory trees on a few threads and stream the regular files found
+ * into a ChunkQueue, so the JobScheduler starts on the first files while the
+ * rest of the tree is still being listed. Only the directories waiting to be
+ * listed are kept in memory, never the whole file list.
+ *
+ * A root that is a file is passed through as is. Symbolic links to
+ * directories are not followed, hidden files are included (as in
+ * Utils::getDirSize). The queue is closed when the walk is over; closing it
+ * from the consumer side stops the walk.
+ */
+class LIB_EXPORT DirectoryWalker {
+  public:
+    // threads = 0 means WALKER_THREADS
+    explicit DirectoryWalker(quint32 threads = 0);
+    ~DirectoryWalker();
+
+    // files found in the directories are only pushed when filter returns
+    // true, the roots always are
+    void setFilter(std::function<bool(const QFileInfo &)> filter);
+
+    // walk every root in the background, see wait()
+    void start(const QStringList &roots, ChunkQueue<QString> &files);
+
+    // join the walker threads, files is closed by then
+    void wait();
+
+    // directories listed so far
+    quint64 directories() const;
+
+    // true if one of the paths is a directory
+    static bool hasDirectory(const QStringList &paths);
+
+  private:
+    void work(ChunkQueue<QString> &files);
+
+    quint32 m_threads;
+    std::function<bool(const QFileInfo &)> m_filter;
+    std::vector<std::thread> m_pool;
+
+    std::deque<QString> m_pending; // paths waiting to be listed
+    quint32 m_busy        = 0;     // directories being listed
+    quint32 m_running     = 0;     // walker threads not finished yet
+    bool m_stopped        = false; // the consumer closed the queue
+    quint64 m_directories = 0;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_changed;
+};
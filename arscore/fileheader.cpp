@@ -0,0 +1,134 @@
+#include "fileheader.h"
+
+#include "messages.h"
+
+bool FileHeader::archive() const
+{
+    return (magic == consts::ARCHIVE_MAGIC_NUMBER);
+}
+
+bool FileHeader::streamed() const
+{
+    return (fileSize == consts::STREAM_FILE_SIZE);
+}
+
+bool FileHeader::compressed() const
+{
+    return (compression != consts::COMPRESSION_NONE);
+}
+
+bool FileHeader::nameBlock() const
+{
+    return (version >= consts::NAME_BLOCK_VERSION);
+}
+
+qint64 FileHeader::nameBlockSize() const
+{
+    if (archive())
+        return (0);
+    return (fileNameSize + (nameBlock() ? 0 : consts::IN_BUFFER_SIZE) + consts::MACBYTES * 3);
+}
+
+void FileHeader::write(QDataStream &stream) const
+{
+    stream << static_cast<quint32>(magic);
+    stream << static_cast<QVersionNumber>(version);
+    stream << static_cast<quint32>(memlimit);
+    stream << static_cast<quint32>(iterations);
+    stream << static_cast<quint32>(chunkSize);
+    stream << static_cast<quint32>(parallelism);
+    stream << static_cast<quint32>(keyMode);
+    stream << static_cast<quint32>(compression);
+    stream << static_cast<qint64>(fileNameSize);
+    stream << static_cast<qint64>(fileSize);
+
+    stream.writeRawData(reinterpret_cast<const char *>(argonSalt.data()), consts::ARGON_SALT_LEN);
+    if (keyMode == consts::KEY_MODE_MASTER)
+        stream.writeRawData(reinterpret_cast<const char *>(fileSalt.data()), consts::FILE_SALT_LEN);
+    stream.writeRawData(reinterpret_cast<const char *>(tripleNonce.data()), consts::CIPHER_IV_LEN * 3);
+}
+
+quint32 FileHeader::read(QDataStream &stream)
+{
+    stream >> magic;
+    if (magic != consts::MAGIC_NUMBER && magic != consts::ARCHIVE_MAGIC_NUMBER)
+        return (NOT_AN_ARSENIC_FILE);
+
+    stream >> version;
+    if (archive() && version < consts::ARCHIVE_VERSION)
+        return (SRC_HEADER_READ_ERROR);
+
+    // Argon2 parameters
+    stream >> memlimit;
+    stream >> iterations;
+
+    chunkSize = consts::IN_BUFFER_SIZE;
+    if (version >= consts::CHUNK_SIZE_VERSION)
+        stream >> chunkSize;
+
+    if (chunkSize < consts::MIN_CHUNK_SIZE || chunkSize > consts::MAX_CHUNK_SIZE)
+        return (SRC_HEADER_READ_ERROR);
+
+    parallelism = consts::PARALLELISM_INTERACTIVE;
+    if (version >= consts::LANES_VERSION)
+        stream >> parallelism;
+
+    // used as they are to decrypt
+    if (!validArgon(memlimit, iterations, parallelism))
+        return (SRC_HEADER_READ_ERROR);
+
+    keyMode = consts::KEY_MODE_PASSWORD;
+    if (version >= consts::KEY_MODE_VERSION)
+        stream >> keyMode;
+
+    if (keyMode != consts::KEY_MODE_PASSWORD && keyMode != consts::KEY_MODE_MASTER)
+        return (SRC_HEADER_READ_ERROR);
+
+    compression = consts::COMPRESSION_NONE;
+    if (version >= consts::COMPRESSION_VERSION)
+        stream >> compression;
+
+    // archive members are found by the fixed size of the blocks
+    if (compression != consts::COMPRESSION_NONE && (compression != consts::COMPRESSION_ZLIB || archive()))
+        return (SRC_HEADER_READ_ERROR);
+
+    stream >> fileNameSize;
+    stream >> fileSize;
+
+    if (archive() && fileNameSize != 0)
+        return (SRC_HEADER_READ_ERROR);
+
+    if (!archive() && nameBlock() && (fileNameSize < consts::NAME_LENGTH_LEN || fileNameSize > consts::NAME_PADDING_MAX))
+        return (SRC_HEADER_READ_ERROR);
+
+    // On most systems the maximum filename length is 255 bytes
+    if (!nameBlock() && (fileNameSize < 0 || fileNameSize > 255))
+        return (SRC_HEADER_READ_ERROR);
+
+    if (fileSize < 0 && (!streamed() || archive() || version < consts::STREAM_VERSION))
+        return (SRC_HEADER_READ_ERROR);
+
+    // the salt and the three nonces
+    argonSalt.resize(consts::ARGON_SALT_LEN);
+    if (stream.readRawData(reinterpret_cast<char *>(argonSalt.data()), consts::ARGON_SALT_LEN) != static_cast<int>(consts::ARGON_SALT_LEN))
+        return (SRC_HEADER_READ_ERROR);
+
+    fileSalt.resize(keyMode == consts::KEY_MODE_MASTER ? consts::FILE_SALT_LEN : 0);
+    if (stream.readRawData(reinterpret_cast<char *>(fileSalt.data()), fileSalt.size()) != static_cast<int>(fileSalt.size()))
+        return (SRC_HEADER_READ_ERROR);
+
+    tripleNonce.resize(consts::CIPHER_IV_LEN * 3);
+    if (stream.readRawData(reinterpret_cast<char *>(tripleNonce.data()), consts::CIPHER_IV_LEN * 3) != static_cast<int>(consts::CIPHER_IV_LEN * 3))
+        return (SRC_HEADER_READ_ERROR);
+
+    return (stream.status() == QDataStream::Ok ? DECRYPT_SUCCESS : SRC_HEADER_READ_ERROR);
+}
+
+bool FileHeader::validArgon(quint32 memlimit, quint32 iterations, quint32 parallelism)
+{
+    if (parallelism < 1 || parallelism > consts::PARALLELISM_MAX)
+        return (false);
+    if (memlimit < 8 * parallelism || memlimit > consts::MEMLIMIT_CALIBRATION_MAX)
+        return (false);
+    return (iterations >= 1 && iterations <= consts::ITERATION_CALIBRATION_MAX);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <QDataStream>
+#include <QVersionNumber>
+
+#include "botan_all.h"
+#include "consts.h"
+#include "libexport.h"
+
+/* The plain header of an .arsn file or archive, up to the encrypted name
+ * block (see Crypto_Thread::encrypt for the whole format). Fields that came
+ * with a later version get the value older files implicitly use.
+ */
+struct LIB_EXPORT FileHeader {
+    quint32 magic          = consts::MAGIC_NUMBER;
+    QVersionNumber version = consts::APP_VERSION;
+    quint32 memlimit       = 0;
+    quint32 iterations     = 0;
+    quint32 chunkSize      = consts::IN_BUFFER_SIZE;
+    quint32 parallelism    = consts::PARALLELISM_INTERACTIVE;
+    quint32 keyMode        = consts::KEY_MODE_PASSWORD;
+    quint32 compression    = consts::COMPRESSION_NONE;
+    qint64 fileNameSize    = 0; // the size of the name block since NAME_BLOCK_VERSION
+    qint64 fileSize        = 0; // STREAM_FILE_SIZE when written from a stream
+    Botan::SecureVector<quint8> argonSalt;
+    Botan::SecureVector<quint8> fileSalt; // KEY_MODE_MASTER only
+    Botan::SecureVector<quint8> tripleNonce;
+
+    bool archive() const;
+    bool streamed() const;
+    bool compressed() const;
+    // the name block holds the name length and padding (4.5.0 and later)
+    bool nameBlock() const;
+    // bytes of the encrypted name block that follows the header, 0 for an archive
+    qint64 nameBlockSize() const;
+
+    void write(QDataStream &stream) const;
+    // DECRYPT_SUCCESS, NOT_AN_ARSENIC_FILE or SRC_HEADER_READ_ERROR if a
+    // field is out of its bounds or the header is cut short
+    quint32 read(QDataStream &stream);
+
+    // the Argon2 parameters read() accepts: no more than calibration ever
+    // picks, and the 8 KiB per lane Argon2 needs
+    static bool validArgon(quint32 memlimit, quint32 iterations, quint32 parallelism);
+};
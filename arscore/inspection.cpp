@@ -0,0 +1,140 @@
+#include "inspection.h"
+
+#include <QDataStream>
+#include <QFile>
+#include <QJsonArray>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "messages.h"
+
+using namespace std;
+
+namespace {
+qint64 blocks(qint64 size, qint64 chunkSize)
+{
+    return ((size + chunkSize - 1) / chunkSize);
+}
+} // namespace
+
+QJsonObject Inspection::toJson() const
+{
+    QJsonObject json;
+    json["path"]   = path;
+    json["status"] = status == DECRYPT_SUCCESS ? QString("ok") : errorCodeToString(status);
+    json["size"]   = size;
+    if (status != DECRYPT_SUCCESS && status != SRC_HEADER_READ_ERROR)
+        return (json);
+
+    json["type"]         = header.archive() ? "archive" : header.streamed() ? "stream" : "file";
+    json["version"]      = header.version.toString();
+    json["memlimit_kib"] = static_cast<qint64>(header.memlimit);
+    json["iterations"]   = static_cast<qint64>(header.iterations);
+    json["parallelism"]  = static_cast<qint64>(header.parallelism);
+    if (status != DECRYPT_SUCCESS)
+        return (json);
+
+    json["chunk_size"]    = static_cast<qint64>(header.chunkSize);
+    json["key_mode"]      = header.keyMode == consts::KEY_MODE_MASTER ? "master" : "password";
+    json["compression"]   = header.compressed() ? "zlib" : "none";
+    json["original_size"] = header.streamed() ? QJsonValue() : QJsonValue(header.fileSize);
+    json["chunks"]        = chunks >= 0 ? QJsonValue(chunks) : QJsonValue();
+    json["problems"]      = QJsonArray::fromStringList(problems);
+    return (json);
+}
+
+Inspection Inspection::inspect(const QString &path)
+{
+    Inspection inspection;
+    inspection.path = path;
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        inspection.status = SRC_CANNOT_OPEN_READ;
+        return (inspection);
+    }
+    inspection.size = file.size();
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+    auto &header      = inspection.header;
+    inspection.status = header.read(stream);
+    if (inspection.status != DECRYPT_SUCCESS)
+        return (inspection);
+
+    auto &problems        = inspection.problems;
+    inspection.dataOffset = file.pos() + header.nameBlockSize();
+    const auto size       = inspection.size;
+    const auto data       = size - inspection.dataOffset;
+    const qint64 tags     = consts::MACBYTES * 3;
+    const qint64 block    = header.chunkSize + tags;
+
+    if (header.version > consts::APP_VERSION)
+        problems << "written by Arsenic " + header.version.toString() + ", newer than this one";
+    if (data < 0) {
+        problems << "the file ends in its name block";
+        return (inspection);
+    }
+
+    if (header.compressed()) {
+        // every block has a length and a flag, the data may shrink to nothing
+        // but can't grow by more than that. A stream has no bound.
+        if (!header.streamed()) {
+            inspection.chunks  = blocks(header.fileSize, header.chunkSize) + 1;
+            const auto framing = inspection.chunks * (consts::CHUNK_LENGTH_LEN + 1 + tags);
+            if (data < framing || data > header.fileSize + framing)
+                problems << QString("%1 bytes of data blocks, %2 chunks need %3 to %4").arg(data).arg(inspection.chunks).arg(framing).arg(header.fileSize + framing);
+        }
+        return (inspection);
+    }
+
+    if (header.streamed()) {
+        // the last block of a stream is short, empty if needed
+        inspection.chunks = blocks(data, block);
+        const auto last   = data - (inspection.chunks - 1) * block;
+        if (data == 0 || last == block)
+            problems << "the stream ends on a full chunk, it was cut";
+        else if (last < tags)
+            problems << "the last chunk is shorter than its tags";
+        return (inspection);
+    }
+
+    inspection.chunks = blocks(header.fileSize, header.chunkSize);
+    auto expected     = inspection.dataOffset + header.fileSize + inspection.chunks * tags;
+
+    // an archive ends with its encrypted index and the size of it
+    if (header.archive()) {
+        const auto trailer = static_cast<qint64>(sizeof(qint64));
+        qint64 indexSize   = 0;
+        if (size >= expected + trailer && file.seek(size - trailer))
+            stream >> indexSize;
+        if (indexSize < tags) {
+            problems << "no archive index";
+            return (inspection);
+        }
+        expected += indexSize + trailer;
+    }
+
+    if (size != expected)
+        problems << QString("%1 bytes on disk, the header gives %2 (%3)").arg(size).arg(expected).arg(size < expected ? "truncated" : "trailing data");
+    return (inspection);
+}
+
+void Inspection::inspectAll(ChunkQueue<QString> &paths, quint32 threads, const function<void(const Inspection &)> &report)
+{
+    mutex reportMutex;
+    vector<thread> pool;
+    for (quint32 i = 0; i < qMax(threads, 1u); ++i) {
+        pool.emplace_back([&] {
+            QString path;
+            while (paths.pop(path)) {
+                const auto inspection = inspect(path);
+                lock_guard<mutex> lock(reportMutex);
+                report(inspection);
+            }
+        });
+    }
+    for (auto &worker : pool)
+        worker.join();
+}
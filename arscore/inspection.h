@@ -0,0 +1,34 @@
+#pragma once
+
+#include <QJsonObject>
+#include <QString>
+#include <QStringList>
+#include <functional>
+
+#include "chunkqueue.h"
+#include "fileheader.h"
+#include "libexport.h"
+
+/* What the plain header of an .arsn file tells, without the passphrase and
+ * without reading the data blocks: the header itself, and whether the size
+ * of the file agrees with it. Only an archive reads more, the 8 bytes of
+ * its index size at the end.
+ */
+struct LIB_EXPORT Inspection {
+    QString path;
+    // DECRYPT_SUCCESS, or SRC_CANNOT_OPEN_READ, NOT_AN_ARSENIC_FILE and
+    // SRC_HEADER_READ_ERROR, see FileHeader::read
+    quint32 status = 0;
+    FileHeader header;
+    qint64 size       = 0;  // on disk
+    qint64 dataOffset = 0;  // of the first data block
+    qint64 chunks     = -1; // encrypted blocks after the name block, -1 if unknown
+    QStringList problems;   // sizes that don't add up
+
+    QJsonObject toJson() const;
+
+    static Inspection inspect(const QString &path);
+    // inspect every path of the queue on threads workers, until it is
+    // closed. report is called for one file at a time, in no given order.
+    static void inspectAll(ChunkQueue<QString> &paths, quint32 threads, const std::function<void(const Inspection &)> &report);
+};
@@ -0,0 +1,312 @@
+#include "ioengine.h"
+
+#include <cstring>
+
+#include "consts.h"
+
+#if defined(Q_OS_UNIX)
+#include <cerrno>
+#include <unistd.h>
+#endif
+
+#if defined(Q_OS_LINUX) && __has_include(<linux/io_uring.h>)
+#define ARSENIC_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+using namespace std;
+
+#if defined(ARSENIC_IO_URING)
+// the rings shared with the kernel, without liburing
+struct IoEngine::Ring {
+    int fd        = -1;
+    void *sq      = MAP_FAILED;
+    size_t sqSize = 0;
+    void *cq      = MAP_FAILED;
+    size_t cqSize = 0;
+    io_uring_sqe *sqes = static_cast<io_uring_sqe *>(MAP_FAILED);
+    size_t sqesSize    = 0;
+
+    unsigned *sqTail  = nullptr;
+    unsigned *sqMask  = nullptr;
+    unsigned *sqArray = nullptr;
+    unsigned *cqHead  = nullptr;
+    unsigned *cqTail  = nullptr;
+    unsigned *cqMask  = nullptr;
+    io_uring_cqe *cqes = nullptr;
+    std::vector<iovec> iovecs; // by slot
+
+    ~Ring()
+    {
+        if (sqes != MAP_FAILED)
+            munmap(sqes, sqesSize);
+        if (cq != MAP_FAILED && cq != sq)
+            munmap(cq, cqSize);
+        if (sq != MAP_FAILED)
+            munmap(sq, sqSize);
+        if (fd >= 0)
+            close(fd);
+    }
+
+    int enter(unsigned submit, unsigned wait)
+    {
+        int done;
+        do {
+            done = static_cast<int>(syscall(__NR_io_uring_enter, fd, submit, wait, wait > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0));
+        } while (done < 0 && errno == EINTR);
+        return (done);
+    }
+};
+#else
+struct IoEngine::Ring {
+};
+#endif
+
+IoEngine::IoEngine(quint32 depth, bool uring)
+    : m_depth(qBound(1u, depth, consts::IO_DEPTH_MAX)),
+      m_slots(m_depth),
+      m_requests(m_depth),
+      m_completions(m_depth)
+{
+    for (quint32 i = m_depth; i > 0; --i)
+        m_freeSlots.push_back(i - 1);
+
+    if (uring && setupRing()) {
+        m_backend = URING;
+        return;
+    }
+
+    m_ring.reset();
+    const auto threads = qMin(m_depth, consts::IO_THREADS_MAX);
+    for (quint32 i = 0; i < threads; ++i)
+        m_threads.emplace_back(&IoEngine::work, this);
+}
+
+IoEngine::~IoEngine()
+{
+    // the kernel or the threads may still use the buffers
+    IoCompletion completion;
+    while (complete(completion)) {
+    }
+
+    m_requests.close();
+    for (auto &thread : m_threads)
+        thread.join();
+}
+
+bool IoEngine::supported()
+{
+#if defined(Q_OS_UNIX)
+    return (true);
+#else
+    return (false);
+#endif
+}
+
+IoEngine::Backend IoEngine::backend() const
+{
+    return (m_backend);
+}
+
+quint32 IoEngine::depth() const
+{
+    return (m_depth);
+}
+
+quint32 IoEngine::inFlight() const
+{
+    return (m_inFlight);
+}
+
+bool IoEngine::submit(const IoRequest &request)
+{
+    if (m_inFlight >= m_depth)
+        return (false);
+
+    if (m_backend == THREADS) {
+        if (!m_requests.push(IoRequest(request)))
+            return (false);
+        ++m_inFlight;
+        return (true);
+    }
+
+    const auto slot = m_freeSlots.back();
+    m_slots[slot]   = Slot{request, 0};
+    if (!queueRing(slot))
+        return (false);
+    m_freeSlots.pop_back();
+    ++m_inFlight;
+    return (true);
+}
+
+bool IoEngine::complete(IoCompletion &completion)
+{
+    return (reap(completion, true));
+}
+
+bool IoEngine::tryComplete(IoCompletion &completion)
+{
+    return (reap(completion, false));
+}
+
+bool IoEngine::reap(IoCompletion &completion, bool wait)
+{
+    if (m_inFlight == 0)
+        return (false);
+
+    if (m_backend == THREADS) {
+        if (!(wait ? m_completions.pop(completion) : m_completions.tryPop(completion)))
+            return (false);
+        --m_inFlight;
+        return (true);
+    }
+
+#if defined(ARSENIC_IO_URING)
+    for (;;) {
+        // the completion queue is shared memory, looking at it needs no
+        // system call
+        const auto head = *m_ring->cqHead;
+        if (head == __atomic_load_n(m_ring->cqTail, __ATOMIC_ACQUIRE)) {
+            if (!wait || m_ring->enter(0, 1) < 0)
+                return (false);
+            continue;
+        }
+
+        const auto cqe = m_ring->cqes[head & *m_ring->cqMask];
+        __atomic_store_n(m_ring->cqHead, head + 1, __ATOMIC_RELEASE);
+
+        const auto slot = static_cast<quint32>(cqe.user_data);
+        auto &entry     = m_slots[slot];
+        if (cqe.res > 0)
+            entry.done += cqe.res;
+
+        // a partial transfer goes on from where it stopped
+        auto result = cqe.res < 0 ? cqe.res : (cqe.res == 0 && entry.request.write && entry.request.size > 0 ? -EIO : entry.done);
+        if (cqe.res > 0 && entry.done < entry.request.size) {
+            if (queueRing(slot))
+                continue;
+            result = -EIO;
+        }
+
+        completion.tag    = entry.request.tag;
+        completion.result = result;
+        m_freeSlots.push_back(slot);
+        --m_inFlight;
+        return (true);
+    }
+#else
+    return (false);
+#endif
+}
+
+bool IoEngine::setupRing()
+{
+#if defined(ARSENIC_IO_URING)
+    auto ring = make_unique<Ring>();
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring->fd = static_cast<int>(syscall(__NR_io_uring_setup, m_depth, &params));
+    if (ring->fd < 0)
+        return (false); // ENOSYS, or EPERM in a sandbox
+
+    ring->sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const auto single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single)
+        ring->sqSize = ring->cqSize = qMax(ring->sqSize, ring->cqSize);
+
+    ring->sq = mmap(nullptr, ring->sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq == MAP_FAILED)
+        return (false);
+    ring->cq = single ? ring->sq : mmap(nullptr, ring->cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    if (ring->cq == MAP_FAILED)
+        return (false);
+    ring->sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    ring->sqes     = static_cast<io_uring_sqe *>(mmap(nullptr, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES));
+    if (ring->sqes == MAP_FAILED)
+        return (false);
+
+    auto *sq      = static_cast<char *>(ring->sq);
+    auto *cq      = static_cast<char *>(ring->cq);
+    ring->sqTail  = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    ring->sqMask  = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    ring->sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    ring->cqHead  = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    ring->cqTail  = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    ring->cqMask  = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    ring->cqes    = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+    ring->iovecs.resize(m_depth);
+
+    m_ring = move(ring);
+    return (true);
+#else
+    return (false);
+#endif
+}
+
+bool IoEngine::queueRing(quint32 slot)
+{
+#if defined(ARSENIC_IO_URING)
+    // READV and WRITEV are there since the first io_uring kernels
+    const auto &entry = m_slots[slot];
+    auto &iov         = m_ring->iovecs[slot];
+    iov.iov_base      = entry.request.data + entry.done;
+    iov.iov_len       = static_cast<size_t>(entry.request.size - entry.done);
+
+    // never more requests in flight than entries, the ring can't be full
+    const auto tail  = *m_ring->sqTail;
+    const auto index = tail & *m_ring->sqMask;
+    auto &sqe        = m_ring->sqes[index];
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode    = entry.request.write ? IORING_OP_WRITEV : IORING_OP_READV;
+    sqe.fd        = entry.request.fd;
+    sqe.off       = static_cast<quint64>(entry.request.offset + entry.done);
+    sqe.addr      = reinterpret_cast<quint64>(&iov);
+    sqe.len       = 1;
+    sqe.user_data = slot;
+
+    m_ring->sqArray[index] = index;
+    __atomic_store_n(m_ring->sqTail, tail + 1, __ATOMIC_RELEASE);
+    if (m_ring->enter(1, 0) == 1)
+        return (true);
+
+    // the kernel didn't take it (it only reads the ring in enter): take the
+    // entry back, the caller keeps its buffer and a later enter must not
+    // submit it
+    __atomic_store_n(m_ring->sqTail, tail, __ATOMIC_RELEASE);
+    return (false);
+#else
+    Q_UNUSED(slot);
+    return (false);
+#endif
+}
+
+void IoEngine::work()
+{
+    IoRequest request;
+    while (m_requests.pop(request)) {
+        qint64 done   = 0;
+        qint64 result = 0;
+#if defined(Q_OS_UNIX)
+        while (done < request.size) {
+            const auto bytes = request.write ? pwrite(request.fd, request.data + done, request.size - done, request.offset + done)
+                                             : pread(request.fd, request.data + done, request.size - done, request.offset + done);
+            if (bytes < 0 && errno == EINTR)
+                continue;
+            if (bytes < 0) {
+                result = -errno;
+                break;
+            }
+            if (bytes == 0) {
+                result = request.write ? -EIO : 0;
+                break;
+            }
+            done += bytes;
+        }
+#endif
+        m_completions.push(IoCompletion{request.tag, result < 0 ? result : done});
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <QtGlobal>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "chunkqueue.h"
+#include "libexport.h"
+
+struct IoRequest {
+    int fd        = -1;
+    bool write    = false;
+    quint8 *data  = nullptr;
+    qint64 size   = 0;
+    qint64 offset = 0;
+    quint64 tag   = 0; // given back with the completion
+};
+
+struct IoCompletion {
+    quint64 tag   = 0;
+    qint64 result = 0; // bytes done, size unless a read hit the end of the file, or -errno
+};
+
+/* Reads and writes at given offsets of file descriptors, with up to depth of
+ * them in flight, so the disk works while the caller does something else.
+ * io_uring when the kernel (and the sandbox) allows it, else a pool of
+ * threads doing blocking pread and pwrite. A request is retried until it is
+ * whole, only a read stops short at the end of the file.
+ *
+ * Not thread-safe: submit() and complete() are called from one thread. The
+ * buffers of the requests in flight must live until their completion, the
+ * destructor waits for them.
+ */
+class LIB_EXPORT IoEngine {
+  public:
+    enum Backend { URING, THREADS };
+
+    // uring = false always uses the threads
+    explicit IoEngine(quint32 depth, bool uring = true);
+    ~IoEngine();
+
+    // false on systems without pread and pwrite, the caller keeps its
+    // blocking I/O there
+    static bool supported();
+
+    Backend backend() const;
+    quint32 depth() const;
+    quint32 inFlight() const;
+
+    // false if depth requests are in flight already, or the queue failed
+    bool submit(const IoRequest &request);
+    // wait for the next completion, in no given order. false if nothing is
+    // in flight.
+    bool complete(IoCompletion &completion);
+    // the next completion if one is there already, false without waiting
+    // otherwise
+    bool tryComplete(IoCompletion &completion);
+
+  private:
+    struct Ring;
+    struct Slot {
+        IoRequest request;
+        qint64 done = 0;
+    };
+
+    bool reap(IoCompletion &completion, bool wait);
+    bool setupRing();
+    bool queueRing(quint32 slot);
+    void work();
+
+    quint32 m_depth;
+    quint32 m_inFlight = 0;
+    Backend m_backend  = THREADS;
+
+    // io_uring, with the requests in flight by slot
+    std::unique_ptr<Ring> m_ring;
+    std::vector<Slot> m_slots;
+    std::vector<quint32> m_freeSlots;
+
+    // the threads fallback
+    ChunkQueue<IoRequest> m_requests;
+    ChunkQueue<IoCompletion> m_completions;
+    std::vector<std::thread> m_threads;
+};
@@ -0,0 +1,143 @@
+#include "jobscheduler.h"
+
+#include <QFileInfo>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "consts.h"
+
+using namespace std;
+
+JobScheduler::JobScheduler(quint32 concurrency, quint32 chunkThreads)
+    : m_concurrency(concurrency > 0 ? concurrency : 1),
+      m_chunkThreads(chunkThreads > 0 ? chunkThreads : 1),
+      m_largeFileSize(consts::LARGE_FILE_SIZE)
+{
+}
+
+void JobScheduler::setLargeFileSize(qint64 size)
+{
+    m_largeFileSize = size;
+}
+
+void JobScheduler::setAbortCallback(function<bool()> callback)
+{
+    m_aborted = move(callback);
+}
+
+void JobScheduler::setErrorCallback(function<void(const QString &, const QString &)> callback)
+{
+    m_error = move(callback);
+}
+
+void JobScheduler::run(const QStringList &files, const function<void(const QString &, quint32)> &process)
+{
+    const auto jobs    = order(files);
+    const int count    = jobs.size();
+    const auto aborted = [this] { return m_aborted && m_aborted(); };
+
+    // large files one after the other, each one uses every chunk worker
+    int next = 0;
+    for (; next < count && jobs.at(next).size >= m_largeFileSize; ++next) {
+        if (aborted())
+            return;
+        processFile(process, jobs.at(next).path, m_chunkThreads);
+    }
+
+    const auto small = count - next;
+    if (small <= 0)
+        return;
+
+    // small files in batches, so hundreds of thousands of them don't fight
+    // over the counter, with enough batches left to balance the workers
+    const auto workers = qMin<quint32>(m_concurrency, small);
+    const auto batch   = qBound(1, small / static_cast<int>(workers * 8), consts::SMALL_FILE_BATCH);
+    atomic<int> cursor{next};
+
+    const auto work = [&] {
+        while (!aborted()) {
+            const auto first = cursor.fetch_add(batch);
+            if (first >= count)
+                return;
+
+            const auto last = qMin(first + batch, count);
+            for (auto i = first; i < last && !aborted(); ++i)
+                processFile(process, jobs.at(i).path, 1);
+        }
+    };
+
+    if (workers == 1) {
+        work();
+        return;
+    }
+
+    vector<thread> pool;
+    for (quint32 i = 0; i < workers; ++i)
+        pool.emplace_back(work);
+    for (auto &worker : pool)
+        worker.join();
+}
+
+void JobScheduler::run(ChunkQueue<QString> &files, const function<void(const QString &, quint32)> &process)
+{
+    const auto aborted = [this] { return m_aborted && m_aborted(); };
+
+    QStringList large;
+    mutex largeMutex;
+
+    const auto work = [&] {
+        QString path;
+        while (!aborted() && files.pop(path)) {
+            if (QFileInfo(path).size() >= m_largeFileSize) {
+                lock_guard<mutex> lock(largeMutex);
+                large.append(path);
+            }
+            else {
+                processFile(process, path, 1);
+            }
+        }
+    };
+
+    if (m_concurrency == 1) {
+        work();
+    }
+    else {
+        vector<thread> pool;
+        for (quint32 i = 0; i < m_concurrency; ++i)
+            pool.emplace_back(work);
+        for (auto &worker : pool)
+            worker.join();
+    }
+
+    // lets the producer go if we stopped early
+    files.close();
+    if (aborted())
+        return;
+
+    run(large, process);
+}
+
+void JobScheduler::processFile(const function<void(const QString &, quint32)> &process, const QString &path, quint32 threads) const
+{
+    try {
+        process(path, threads);
+    }
+    catch (const std::exception &e) {
+        if (m_error)
+            m_error(path, QString::fromLocal8Bit(e.what()));
+    }
+}
+
+QList<JobScheduler::Job> JobScheduler::order(const QStringList &files)
+{
+    QList<Job> jobs;
+    for (const auto &file : files)
+        jobs.append({file, QFileInfo(file).size()});
+
+    // stable, so files of the same size keep the order of the list
+    std::stable_sort(jobs.begin(), jobs.end(), [](const Job &a, const Job &b) { return a.size > b.size; });
+    return (jobs);
+}
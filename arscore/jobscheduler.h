@@ -0,0 +1,60 @@
+#pragma once
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <functional>
+
+#include "chunkqueue.h"
+#include "libexport.h"
+
+/* Work through the files of a job on a bounded pool of threads.
+ *
+ * The files are ordered by size, largest first. Large files (from
+ * largeFileSize bytes) are processed one at a time with every chunk worker
+ * (see ChunkPipeline), small files are handed out in batches to up to
+ * concurrency file workers, each with a single chunk worker. So at most
+ * max(chunkThreads, concurrency) crypto threads run at once.
+ */
+class LIB_EXPORT JobScheduler {
+  public:
+    struct Job {
+        QString path;
+        qint64 size = 0;
+    };
+
+    JobScheduler(quint32 concurrency, quint32 chunkThreads);
+
+    // LARGE_FILE_SIZE by default
+    void setLargeFileSize(qint64 size);
+    // polled before every file, return true to stop handing out files
+    void setAbortCallback(std::function<bool()> callback);
+    // called with the path and the reason when process() throws for a file
+    // (e.g. std::bad_alloc), from the thread that ran it. The job goes on
+    // with the next file.
+    void setErrorCallback(std::function<void(const QString &, const QString &)> callback);
+
+    // process(path, chunkThreads) is called once per file, from several
+    // threads at once for the small files
+    void run(const QStringList &files, const std::function<void(const QString &, quint32)> &process);
+
+    // same, for files streamed by a producer (see DirectoryWalker). The order
+    // is not known in advance: small files are processed as they come, large
+    // ones are kept aside and processed, largest first, once files is closed
+    // and drained. files is closed on return, which stops the producer.
+    void run(ChunkQueue<QString> &files, const std::function<void(const QString &, quint32)> &process);
+
+    // the files with their size, largest first
+    static QList<Job> order(const QStringList &files);
+
+  private:
+    // process(path, threads), nothing thrown leaves it: the pool threads
+    // would terminate the program
+    void processFile(const std::function<void(const QString &, quint32)> &process, const QString &path, quint32 threads) const;
+
+    quint32 m_concurrency;
+    quint32 m_chunkThreads;
+    qint64 m_largeFileSize;
+    std::function<bool()> m_aborted;
+    std::function<void(const QString &, const QString &)> m_error;
+};
@@ -0,0 +1,62 @@
+#include "journal.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QFile>
+#include <QSaveFile>
+
+QString Journal::pathFor(const QString &arsn)
+{
+    return (arsn + consts::JOURNAL_EXTENSION);
+}
+
+void Journal::setSource(const QFileInfo &source)
+{
+    sourceSize     = source.size();
+    sourceModified = source.lastModified().toMSecsSinceEpoch();
+}
+
+bool Journal::matches(const QFileInfo &source) const
+{
+    return (source.size() == sourceSize && source.lastModified().toMSecsSinceEpoch() == sourceModified);
+}
+
+bool Journal::load()
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return (false);
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic;
+    stream >> magic;
+    if (magic != consts::JOURNAL_MAGIC)
+        return (false);
+
+    stream >> direction >> sourceSize >> sourceModified >> output >> chunks;
+    state.resize(consts::TAG_STATE_LEN);
+    if (stream.readRawData(reinterpret_cast<char *>(state.data()), state.size()) != static_cast<int>(state.size()))
+        return (false);
+    return (stream.status() == QDataStream::Ok && !output.isEmpty());
+}
+
+bool Journal::save() const
+{
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return (false);
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << static_cast<quint32>(consts::JOURNAL_MAGIC);
+    stream << direction << sourceSize << sourceModified << output << chunks;
+    stream.writeRawData(reinterpret_cast<const char *>(state.data()), state.size());
+    return (stream.status() == QDataStream::Ok && file.commit());
+}
+
+bool Journal::remove() const
+{
+    return (!QFile::exists(path) || QFile::remove(path));
+}
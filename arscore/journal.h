@@ -0,0 +1,37 @@
+#pragma once
+
+#include <QFileInfo>
+#include <QString>
+
+#include "botan_all.h"
+#include "consts.h"
+#include "libexport.h"
+
+/* Sidecar of a resumable job, "<file>.arsn.journal" next to the encrypted
+ * file. The pipeline checkpoints every JOURNAL_INTERVAL bytes: the output is
+ * synced to disk first, then the journal records how many data blocks are
+ * durable and the hash chain of their tags (see ChunkPipeline::chainTags).
+ * A rerun replays the chain from the .arsn and continues after the last
+ * checkpoint; the nonce of a block only depends on its index.
+ */
+struct LIB_EXPORT Journal {
+    QString path;
+    bool direction        = true; // encryption
+    qint64 sourceSize     = 0;
+    qint64 sourceModified = 0;    // ms since epoch
+    QString output;               // the file being written
+    quint64 chunks = 0;           // durable data blocks
+    Botan::SecureVector<quint8> state;
+
+    static QString pathFor(const QString &arsn);
+
+    void setSource(const QFileInfo &source);
+    // the source is still the one the journal was written for
+    bool matches(const QFileInfo &source) const;
+
+    // false if path is missing or not a journal
+    bool load();
+    // replace the journal at once, a crash leaves the old one or the new one
+    bool save() const;
+    bool remove() const;
+};
@@ -0,0 +1,104 @@
+#include "keycache.h"
+
+#include "cryptoengine.h"
+
+using namespace Botan;
+using namespace std;
+
+bool KeyCache::contains(const SecureVector<quint8> &salt, quint32 memlimit, quint32 iterations, quint32 parallelism) const
+{
+    lock_guard<mutex> lock(m_mutex);
+    return (m_keys.count(Params(vector<quint8>(salt.begin(), salt.end()), memlimit, iterations, parallelism)) > 0);
+}
+
+SecureVector<quint8> KeyCache::key(const QString &password,
+                                   const SecureVector<quint8> &salt,
+                                   quint32 memlimit,
+                                   quint32 iterations,
+                                   quint32 parallelism,
+                                   bool keep)
+{
+    const Params params(vector<quint8>(salt.begin(), salt.end()), memlimit, iterations, parallelism);
+
+    unique_lock<mutex> lock(m_mutex);
+    // wait for the same key derived by another thread, or for room in the budget
+    m_changed.wait(lock, [&] {
+        return (m_keys.count(params) > 0 || (m_pending.count(params) == 0 && (m_inFlight == 0 || m_inFlight + memlimit <= m_budget)));
+    });
+
+    const auto found = m_keys.find(params);
+    if (found != m_keys.end()) {
+        found->second.used = ++m_uses;
+        return (found->second.key);
+    }
+
+    m_pending.insert(params);
+    m_inFlight += memlimit;
+    lock.unlock();
+
+    CryptoEngine engine;
+    SecureVector<quint8> key;
+    try {
+        engine.setSalt(salt);
+        engine.derivePassword(password, memlimit, iterations, parallelism);
+        key = engine.key();
+    }
+    catch (...) {
+        lock.lock();
+        m_pending.erase(params);
+        m_inFlight -= memlimit;
+        m_changed.notify_all();
+        throw;
+    }
+
+    lock.lock();
+    m_pending.erase(params);
+    m_inFlight -= memlimit;
+    ++m_derivations;
+    if (keep && m_capacity > 0) {
+        m_keys[params] = Entry{key, ++m_uses};
+        evict();
+    }
+    m_changed.notify_all();
+    return (key);
+}
+
+void KeyCache::evict()
+{
+    while (m_keys.size() > m_capacity) {
+        auto oldest = m_keys.begin();
+        for (auto it = m_keys.begin(); it != m_keys.end(); ++it) {
+            if (it->second.used < oldest->second.used)
+                oldest = it;
+        }
+        m_keys.erase(oldest);
+    }
+}
+
+void KeyCache::setMemoryBudget(quint64 memory)
+{
+    lock_guard<mutex> lock(m_mutex);
+    m_budget = memory;
+    m_changed.notify_all();
+}
+
+void KeyCache::setCapacity(size_t capacity)
+{
+    lock_guard<mutex> lock(m_mutex);
+    m_capacity = capacity;
+    evict();
+}
+
+void KeyCache::clear()
+{
+    // SecureVector wipes the keys when they are freed
+    lock_guard<mutex> lock(m_mutex);
+    m_keys.clear();
+    m_derivations = 0;
+}
+
+quint64 KeyCache::derivations() const
+{
+    lock_guard<mutex> lock(m_mutex);
+    return (m_derivations);
+}
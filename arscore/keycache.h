@@ -0,0 +1,71 @@
+#pragma once
+
+#include <QString>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <tuple>
+#include <vector>
+
+#include "botan_all.h"
+#include "consts.h"
+#include "libexport.h"
+
+/* Argon2 outputs keyed by (salt, memlimit, iterations, lanes), so the files
+ * that share a salt (every file of a batch) run Argon2 once, and a file
+ * decrypted again with the same password (preview, then extract) doesn't run
+ * it at all. Entries are only valid for one password: clear() the cache when
+ * it changes. At most capacity keys are kept, the least recently used goes
+ * first. Keys are held in SecureVector (Botan's locked pool when the system
+ * allows it), wiped on eviction, by clear() and on destruction.
+ *
+ * key() may be called from several threads. A key being derived is never
+ * derived twice, and the Argon2 runs in flight together never use more than
+ * the memory budget (one run always goes, whatever its memlimit).
+ */
+class LIB_EXPORT KeyCache {
+  public:
+    bool contains(const Botan::SecureVector<quint8> &salt, quint32 memlimit, quint32 iterations, quint32 parallelism) const;
+
+    // the Argon2 output for these parameters, derived on the first call only.
+    // keep = false for a salt used once, the key is then not cached.
+    Botan::SecureVector<quint8> key(const QString &password,
+                                    const Botan::SecureVector<quint8> &salt,
+                                    quint32 memlimit,
+                                    quint32 iterations,
+                                    quint32 parallelism,
+                                    bool keep = true);
+
+    // KiB of Argon2 memory in use at once, ARGON_MEMORY_BUDGET by default
+    void setMemoryBudget(quint64 memory);
+    // keys kept at most, KEY_CACHE_SIZE by default
+    void setCapacity(size_t capacity);
+
+    void clear();
+
+    // Argon2 runs since the last clear()
+    quint64 derivations() const;
+
+  private:
+    using Params = std::tuple<std::vector<quint8>, quint32, quint32, quint32>;
+
+    struct Entry {
+        Botan::SecureVector<quint8> key;
+        quint64 used = 0; // m_uses at the last lookup
+    };
+
+    void evict();
+
+    std::map<Params, Entry> m_keys;
+    std::set<Params> m_pending; // keys being derived
+    size_t m_capacity     = consts::KEY_CACHE_SIZE;
+    quint64 m_uses        = 0;
+    quint64 m_budget      = consts::ARGON_MEMORY_BUDGET;
+    quint64 m_inFlight    = 0; // KiB used by the running derivations
+    quint64 m_derivations = 0;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_changed;
+};
@@ -57,6 +57,22 @@ QString errorCodeToString(quint32 error_code)
         case BAD_CRYPTOBOX_PEM_HEADER:
             ret_string += QObject::tr("Bad Arsenic CryptoBox header.");
             break;
+
+        case INVALID_RANGE:
+            ret_string += QObject::tr("The requested range is outside of the original file.");
+            break;
+
+        case ARCHIVE_MEMBER_NOT_FOUND:
+            ret_string += QObject::tr("The requested file is not in the archive.");
+            break;
+
+        case CRYPT_FAIL:
+            ret_string += QObject::tr("Encryption Failure. The data could not be encrypted.");
+            break;
+
+        case KEY_DERIVATION_FAIL:
+            ret_string += QObject::tr("The key could not be derived. Not enough memory for these Argon2 parameters.");
+            break;
     }
     return (ret_string);
 }
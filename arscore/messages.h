@@ -17,7 +17,11 @@ enum : quint32 {
     INVALID_CRYPTOBOX_IMPUT,
     BAD_CRYPTOBOX_VERSION,
     BAD_CRYPTOBOX_PEM_HEADER,
-    EMPTY_PASSWORD
+    EMPTY_PASSWORD,
+    INVALID_RANGE,
+    ARCHIVE_MEMBER_NOT_FOUND,
+    CRYPT_FAIL,
+    KEY_DERIVATION_FAIL
 };
 
 QString LIB_EXPORT errorCodeToString(quint32 error_code);
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Bounded lock-free rings passing items (chunk descriptors, buffers) between
+// threads without a mutex. tryPush() fails when the ring is full, tryPop()
+// when it is empty: the caller decides whether to spin, yield or sleep, see
+// ChunkQueue. The slots are allocated once and every slot and index sits on
+// its own cache line, so the producers and the consumers never write to the
+// same line.
+
+constexpr size_t RING_CACHE_LINE = 64;
+
+// One producer thread and one consumer thread. Each side keeps a copy of the
+// other one's index and only reads the shared one when the copy says the
+// ring is full (or empty).
+template <typename T>
+class SpscRing {
+  public:
+    explicit SpscRing(size_t capacity)
+        : m_slots(capacity > 0 ? capacity : 1)
+    {
+    }
+
+    size_t capacity() const
+    {
+        return (m_slots.size());
+    }
+
+    bool tryPush(T &&item)
+    {
+        const auto tail = m_producer.index.load(std::memory_order_relaxed);
+        if (tail - m_producer.cached == m_slots.size()) {
+            m_producer.cached = m_consumer.index.load(std::memory_order_acquire);
+            if (tail - m_producer.cached == m_slots.size())
+                return (false);
+        }
+
+        m_slots[tail % m_slots.size()].item = std::move(item);
+        m_producer.index.store(tail + 1, std::memory_order_release);
+        return (true);
+    }
+
+    bool tryPop(T &item)
+    {
+        const auto head = m_consumer.index.load(std::memory_order_relaxed);
+        if (head == m_consumer.cached) {
+            m_consumer.cached = m_producer.index.load(std::memory_order_acquire);
+            if (head == m_consumer.cached)
+                return (false);
+        }
+
+        item = std::move(m_slots[head % m_slots.size()].item);
+        m_consumer.index.store(head + 1, std::memory_order_release);
+        return (true);
+    }
+
+  private:
+    struct alignas(RING_CACHE_LINE) Slot {
+        T item;
+    };
+    // index counts the items pushed (or popped) since the start, cached is
+    // the last value read of the other side's index
+    struct alignas(RING_CACHE_LINE) Side {
+        std::atomic<size_t> index{0};
+        size_t cached = 0;
+    };
+
+    std::vector<Slot> m_slots;
+    Side m_producer;
+    Side m_consumer;
+};
+
+// Any number of producer and consumer threads (Dmitry Vyukov's bounded
+// queue). Every slot has a sequence number telling which lap of the ring
+// may use it next: a producer claims position pos when the sequence is pos,
+// a consumer when it is pos + 1. A thread only waits for another one that
+// claimed a slot and hasn't filled or emptied it yet. With a single slot a
+// full one would look free for the next lap, so there are 2 at least.
+template <typename T>
+class MpmcRing {
+  public:
+    explicit MpmcRing(size_t capacity)
+        : m_slots(capacity > 1 ? capacity : 2)
+    {
+        for (size_t i = 0; i < m_slots.size(); ++i)
+            m_slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    size_t capacity() const
+    {
+        return (m_slots.size());
+    }
+
+    bool tryPush(T &&item)
+    {
+        auto pos = m_tail.index.load(std::memory_order_relaxed);
+        for (;;) {
+            auto &slot     = m_slots[pos % m_slots.size()];
+            const auto seq = slot.sequence.load(std::memory_order_acquire);
+            const auto lap = static_cast<std::ptrdiff_t>(seq - pos);
+            if (lap == 0) {
+                if (m_tail.index.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.item = std::move(item);
+                    slot.sequence.store(pos + 1, std::memory_order_release);
+                    return (true);
+                }
+            }
+            else if (lap < 0) {
+                return (false); // not popped yet since the last lap: full
+            }
+            else {
+                pos = m_tail.index.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool tryPop(T &item)
+    {
+        auto pos = m_head.index.load(std::memory_order_relaxed);
+        for (;;) {
+            auto &slot     = m_slots[pos % m_slots.size()];
+            const auto seq = slot.sequence.load(std::memory_order_acquire);
+            const auto lap = static_cast<std::ptrdiff_t>(seq - (pos + 1));
+            if (lap == 0) {
+                if (m_head.index.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    item = std::move(slot.item);
+                    slot.sequence.store(pos + m_slots.size(), std::memory_order_release);
+                    return (true);
+                }
+            }
+            else if (lap < 0) {
+                return (false); // not pushed yet: empty
+            }
+            else {
+                pos = m_head.index.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+  private:
+    struct alignas(RING_CACHE_LINE) Slot {
+        std::atomic<size_t> sequence{0};
+        T item;
+    };
+    struct alignas(RING_CACHE_LINE) Index {
+        std::atomic<size_t> index{0};
+    };
+
+    std::vector<Slot> m_slots;
+    Index m_tail;
+    Index m_head;
+};
@@ -6,6 +6,13 @@
 #include <QStringBuilder>
 #include "botan_all.h"
 
+#if defined(Q_OS_WIN)
+#include <io.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
 Utils::Utils(QObject *parent)
     : QObject(parent)
 {
@@ -101,6 +108,21 @@ QString Utils::getFileSize(qint64 size)
     }
 }
 
+namespace {
+// "name (copy).ext" next to fileName
+QString copyName(const QFileInfo &originalFile, int copy)
+{
+    // Write number of copies before file extension
+    QString copyName = originalFile.absolutePath() % QDir::separator() % originalFile.baseName() % QString{" (%1)"}.arg(copy);
+
+    if (!originalFile.completeSuffix().isEmpty()) // Add the file extension if there is one
+    {
+        copyName += QStringLiteral(".") % originalFile.completeSuffix();
+    }
+    return (copyName);
+}
+} // namespace
+
 QString Utils::uniqueFileName(const QString &fileName)
 {
     QFileInfo originalFile(fileName);
@@ -109,14 +131,8 @@ QString Utils::uniqueFileName(const QString &fileName)
     auto i                   = 0;
     while (!foundUniqueFileName && i < 100000) {
         QFileInfo uniqueFile(uniqueFileName);
-        if (uniqueFile.exists() && uniqueFile.isFile()) // Write number of copies before file extension
-        {
-            uniqueFileName = originalFile.absolutePath() % QDir::separator() % originalFile.baseName() % QString{" (%1)"}.arg(i + 2);
-
-            if (!originalFile.completeSuffix().isEmpty()) // Add the file extension if there is one
-            {
-                uniqueFileName += QStringLiteral(".") % originalFile.completeSuffix();
-            }
+        if (uniqueFile.exists() && uniqueFile.isFile()) {
+            uniqueFileName = copyName(originalFile, i + 2);
             ++i;
         }
         else {
@@ -125,3 +141,30 @@ QString Utils::uniqueFileName(const QString &fileName)
     }
     return (uniqueFileName);
 }
+
+bool Utils::openUniqueFile(QFile &file, const QString &fileName, QIODevice::OpenMode mode)
+{
+    // NewOnly is O_EXCL: two jobs can't both create the same name, the
+    // second one moves on to the next copy
+    QFileInfo originalFile(fileName);
+    for (auto i = 0; i < 100000; ++i) {
+        file.setFileName(i == 0 ? fileName : copyName(originalFile, i + 1));
+        if (file.open(mode | QIODevice::NewOnly))
+            return (true);
+        if (!file.exists())
+            return (false);
+    }
+    return (false);
+}
+
+bool Utils::syncFile(QFileDevice &file)
+{
+    if (!file.flush())
+        return (false);
+
+#if defined(Q_OS_WIN)
+    return (FlushFileBuffers(reinterpret_cast<HANDLE>(_get_osfhandle(file.handle()))) != 0);
+#else
+    return (fsync(file.handle()) == 0);
+#endif
+}
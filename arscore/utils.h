@@ -1,6 +1,8 @@
 #pragma once
 
 #include <QDebug>
+#include <QFile>
+#include <QFileDevice>
 #include <QObject>
 #include "libexport.h"
 
@@ -13,6 +15,11 @@ class LIB_EXPORT Utils : public QObject {
     static void clearDir(const QString &dir_path);
     static QString getTempPath();
     static QString uniqueFileName(const QString &fileName);
+    // open fileName, or "name (2).ext" and so on, with mode, creating it: the
+    // name is only taken if no other thread or process created it first
+    static bool openUniqueFile(QFile &file, const QString &fileName, QIODevice::OpenMode mode);
+    // flush file and wait until its data is on the disk
+    static bool syncFile(QFileDevice &file);
 
   signals:
 };
@@ -7,9 +7,11 @@ SUBDIRS += 3rdparty \
            arscore \
            arsenic \
            arsenic_gui \
-           tests
+           tests \
+           benchmarks
 
 arscore.depends = 3rdparty
 arsenic.depends = arscore
 arsenic_gui.depends = arscore
 tests.depends = arscore 
+benchmarks.depends = arscore
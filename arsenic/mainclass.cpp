@@ -1,8 +1,14 @@
 #include "mainclass.h"
 #include <QDebug>
+#include <QFile>
+#include <QJsonDocument>
 #include <QStringList>
 #include <iostream>
 
+#include "directorywalker.h"
+#include "inspection.h"
+#include "messages.h"
+
 using namespace std;
 
 MainClass::MainClass(QObject *parent)
@@ -35,12 +41,11 @@ void MainClass::run()
     // you must call quit when complete or the program will stay in the
     // messaging loop
     // qDebug() << "MainClass.Run is executing";
-    greetings();
     QCommandLineParser parser;
     parser.setApplicationDescription(m_const->APP_DESCRIPTION);
     parser.addHelpOption();
     parser.addVersionOption();
-    parser.addPositionalArgument("source", QCoreApplication::translate("main", "Source file to encrypt or decrypt."));
+    parser.addPositionalArgument("source", QCoreApplication::translate("main", "Source files or directories to encrypt or decrypt. Directories are walked recursively."), "source...");
 
     QCommandLineOption passphraseOption(QStringList() << "p"
                                                       << "passphrase"
@@ -53,14 +58,175 @@ void MainClass::run()
                                        QCoreApplication::translate("main", "ENCRYPT or DECRYPT <source>."), QCoreApplication::translate("main", "direction"));
     parser.addOption(directionOption);
 
+    QCommandLineOption rangeOption(QStringList() << "r"
+                                                 << "range",
+                                   QCoreApplication::translate("main", "With DECRYPT, only decrypt <length> bytes of the original file starting at <offset>."), QCoreApplication::translate("main", "offset:length"));
+    parser.addOption(rangeOption);
+
+    QCommandLineOption mmapOption(QStringList() << "m"
+                                                << "mmap",
+                                  QCoreApplication::translate("main", "Use memory mapped I/O for <source> and its output."));
+    parser.addOption(mmapOption);
+
+    QCommandLineOption directOption(QStringList() << "direct-io",
+                                    QCoreApplication::translate("main", "Read <source> and write its output without the page cache (O_DIRECT), for bulk jobs next to cache-sensitive services."));
+    parser.addOption(directOption);
+
+    QCommandLineOption ioDepthOption(QStringList() << "io-depth",
+                                     QCoreApplication::translate("main", "Keep up to <depth> reads and writes in flight (io_uring, or threads where it is missing), for fast NVMe and network file systems."), QCoreApplication::translate("main", "depth"));
+    parser.addOption(ioDepthOption);
+
+    QCommandLineOption memoryOption(QStringList() << "memory-budget",
+                                    QCoreApplication::translate("main", "Hold at most <MiB> of data blocks in memory at once, 512 by default, 0 for no limit. Reading waits for writing past it."), QCoreApplication::translate("main", "MiB"));
+    parser.addOption(memoryOption);
+
+    QCommandLineOption chunkSizeOption(QStringList() << "c"
+                                                     << "chunk-size",
+                                       QCoreApplication::translate("main", "With ENCRYPT, size of the data blocks in KiB, from 64 to 8192. Chosen from the file size by default."), QCoreApplication::translate("main", "KiB"));
+    parser.addOption(chunkSizeOption);
+
+    QCommandLineOption namePaddingOption(QStringList() << "name-padding",
+                                         QCoreApplication::translate("main", "With ENCRYPT, pad the encrypted file name to a multiple of <bytes>, from 0 (no padding) to 65536 (default 256)."), QCoreApplication::translate("main", "bytes"));
+    parser.addOption(namePaddingOption);
+
+    QCommandLineOption compressOption(QStringList() << "z"
+                                                    << "compress",
+                                      QCoreApplication::translate("main", "With ENCRYPT, compress the data before encrypting it. Chunks that don't compress are stored as they are."));
+    parser.addOption(compressOption);
+
+    QCommandLineOption resumeOption(QStringList() << "resume",
+                                    QCoreApplication::translate("main", "Keep a journal next to every .arsn, so an interrupted job continues from its last checkpoint when it is run again."));
+    parser.addOption(resumeOption);
+
+    QCommandLineOption batchOption(QStringList() << "b"
+                                                 << "batch",
+                                   QCoreApplication::translate("main", "With ENCRYPT, run Argon2 once for all the sources and derive the key of every file from it."));
+    parser.addOption(batchOption);
+
+    QCommandLineOption archiveOption(QStringList() << "a"
+                                                   << "archive",
+                                     QCoreApplication::translate("main", "With ENCRYPT, pack all the sources in the single encrypted archive <file>."), QCoreApplication::translate("main", "file"));
+    parser.addOption(archiveOption);
+
+    QCommandLineOption extractOption(QStringList() << "x"
+                                                   << "extract",
+                                     QCoreApplication::translate("main", "With DECRYPT of an archive, only extract <path>, a file or a folder of the archive."), QCoreApplication::translate("main", "path"));
+    parser.addOption(extractOption);
+
+    QCommandLineOption jobsOption(QStringList() << "j"
+                                                << "jobs",
+                                  QCoreApplication::translate("main", "Number of small files processed at once (default one per core). Large files always use every core."), QCoreApplication::translate("main", "files"));
+    parser.addOption(jobsOption);
+
+    QCommandLineOption lanesOption(QStringList() << "l"
+                                                 << "lanes",
+                                   QCoreApplication::translate("main", "With ENCRYPT or --calibrate, number of Argon2 lanes, from 1 to 64, derived in parallel (default 4, picked by --calibrate)."), QCoreApplication::translate("main", "lanes"));
+    parser.addOption(lanesOption);
+
+    QCommandLineOption memlimitOption(QStringList() << "memlimit",
+                                      QCoreApplication::translate("main", "With ENCRYPT, Argon2 memory in MiB, from 1 to 4096 (default 512), e.g. memlimit_kib / 1024 of --calibrate."), QCoreApplication::translate("main", "MiB"));
+    parser.addOption(memlimitOption);
+
+    QCommandLineOption iterationsOption(QStringList() << "iterations",
+                                        QCoreApplication::translate("main", "With ENCRYPT, Argon2 iterations, from 1 to 16 (default 2), e.g. the iterations of --calibrate."), QCoreApplication::translate("main", "iterations"));
+    parser.addOption(iterationsOption);
+
+    QCommandLineOption calibrateOption(QStringList() << "calibrate",
+                                       QCoreApplication::translate("main", "Find the strongest Argon2 parameters that derive a key in about <ms> milliseconds on this machine, and print them as JSON."), QCoreApplication::translate("main", "ms"));
+    parser.addOption(calibrateOption);
+
+    QCommandLineOption inspectOption(QStringList() << "inspect",
+                                     QCoreApplication::translate("main", "Print the plain header of every .arsn <source> (directories are walked) as one JSON object per line, without the passphrase and without reading the data."));
+    parser.addOption(inspectOption);
+
+    QCommandLineOption maxMemoryOption(QStringList() << "max-memory",
+                                       QCoreApplication::translate("main", "With --calibrate, the most memory Argon2 may use, in MiB (default 4096)."), QCoreApplication::translate("main", "MiB"));
+    parser.addOption(maxMemoryOption);
+
     // Process the actual command line arguments given by the user
     parser.process(*app);
 
+    auto lanes = m_const->PARALLELISM_DEFAULT;
+    if (parser.isSet(lanesOption)) {
+        auto valid = false;
+        lanes      = parser.value(lanesOption).toUInt(&valid);
+
+        if (!valid || lanes < 1 || lanes > m_const->PARALLELISM_MAX) {
+            cerr << "ERROR: INVALID LANES" << endl;
+            cerr << "The number of lanes must be between 1 and 64" << endl;
+            quit();
+            return;
+        }
+    }
+
+    // only JSON on stdout, so the result can be piped
+    if (parser.isSet(calibrateOption)) {
+        calibrate(parser.value(calibrateOption), parser.value(maxMemoryOption), parser.isSet(lanesOption) ? lanes : 0);
+        quit();
+        return;
+    }
+
+    // the moderate presets unless given, e.g. from the result of --calibrate
+    ArgonParams argon;
+    argon.memlimit    = m_const->MEMLIMIT_MODERATE;
+    argon.iterations  = m_const->ITERATION_MODERATE;
+    argon.parallelism = lanes;
+    auto validArgon   = true;
+    if (parser.isSet(memlimitOption)) {
+        auto valid     = false;
+        const auto mib = parser.value(memlimitOption).toUInt(&valid);
+        argon.memlimit = mib * 1024;
+        validArgon &= valid && mib <= m_const->MEMLIMIT_CALIBRATION_MAX / 1024;
+    }
+    if (parser.isSet(iterationsOption)) {
+        auto valid       = false;
+        argon.iterations = parser.value(iterationsOption).toUInt(&valid);
+        validArgon &= valid;
+    }
+    if (!validArgon || !FileHeader::validArgon(argon.memlimit, argon.iterations, argon.parallelism)) {
+        cerr << "ERROR: INVALID ARGON2 PARAMETERS" << endl;
+        cerr << "The memlimit must be between 1 and 4096 MiB, and the iterations between 1 and 16" << endl;
+        app->exit(EXIT_FAILURE);
+        return;
+    }
+
     const QStringList args = parser.positionalArguments();
     // source is args.at(0)
 
-    if (args.size() == 1 && parser.isSet(passphraseOption) && parser.isSet(directionOption)) {
-        const auto targetFile = args.at(0);
+    // a non-zero status when a file has a problem, for scripts
+    if (parser.isSet(inspectOption) && !args.isEmpty()) {
+        auto threads = m_const->INSPECT_THREADS;
+        if (parser.isSet(jobsOption)) {
+            auto valid = false;
+            threads    = parser.value(jobsOption).toUInt(&valid);
+
+            if (!valid || threads == 0) {
+                cerr << "ERROR: INVALID JOBS" << endl;
+                cerr << "The number of jobs must be 1 or more" << endl;
+                app->exit(EXIT_FAILURE);
+                return;
+            }
+        }
+
+        if (inspect(args, threads))
+            quit();
+        else
+            app->exit(EXIT_FAILURE);
+        return;
+    }
+
+    // no source or "-": from stdin to stdout, only the data on stdout
+    if ((args.isEmpty() || args == QStringList{"-"}) && parser.isSet(passphraseOption) && parser.isSet(directionOption)) {
+        if (stream(parser.value(directionOption), parser.value(passphraseOption), argon, parser.isSet(compressOption)))
+            quit();
+        else
+            app->exit(EXIT_FAILURE);
+        return;
+    }
+
+    greetings();
+
+    if (!args.isEmpty() && parser.isSet(passphraseOption) && parser.isSet(directionOption)) {
         const auto passphrase = parser.value(passphraseOption);
         const auto direction  = parser.value(directionOption);
 
@@ -75,11 +241,85 @@ void MainClass::run()
             cout << "Passphrase must be minimum 8 characters" << endl;
             quit();
         }
-        QStringList list;
-        list.append(targetFile);
+        const auto list = args;
+
+        m_crypto->setMemoryMapped(parser.isSet(mmapOption));
+        m_crypto->setDirectIo(parser.isSet(directOption));
+        m_crypto->setResumable(parser.isSet(resumeOption));
+
+        if (parser.isSet(ioDepthOption)) {
+            auto valid       = false;
+            const auto depth = parser.value(ioDepthOption).toUInt(&valid);
+
+            if (!valid || depth == 0 || depth > m_const->IO_DEPTH_MAX) {
+                cout << "ERROR: INVALID I/O DEPTH" << endl;
+                cout << "The I/O depth must be between 1 and " << m_const->IO_DEPTH_MAX << endl;
+                quit();
+                return;
+            }
+            m_crypto->setIoDepth(depth);
+        }
+
+        if (parser.isSet(memoryOption)) {
+            auto valid        = false;
+            const auto budget = parser.value(memoryOption).toULongLong(&valid);
+
+            if (!valid || budget > 1048576) {
+                cout << "ERROR: INVALID MEMORY BUDGET" << endl;
+                cout << "The memory budget must be between 0 and 1048576 MiB" << endl;
+                quit();
+                return;
+            }
+            m_crypto->setMemoryBudget(budget * 1048576);
+        }
+
+        if (parser.isSet(jobsOption)) {
+            auto valid      = false;
+            const auto jobs = parser.value(jobsOption).toUInt(&valid);
+
+            if (!valid || jobs == 0) {
+                cout << "ERROR: INVALID JOBS" << endl;
+                cout << "The number of jobs must be 1 or more" << endl;
+                quit();
+                return;
+            }
+            m_crypto->setConcurrency(jobs);
+        }
 
         if (direction == "ENCRYPT") {
             m_crypto->setParam(true, list, passphrase, 1, 1, false);
+            m_crypto->setArgonParameters(argon.memlimit, argon.iterations, argon.parallelism);
+            m_crypto->setBatchMode(parser.isSet(batchOption));
+            m_crypto->setArchive(parser.value(archiveOption));
+            m_crypto->setCompression(parser.isSet(compressOption) ? m_const->COMPRESSION_ZLIB : m_const->COMPRESSION_NONE);
+
+            if (parser.isSet(namePaddingOption)) {
+                auto valid         = false;
+                const auto padding = parser.value(namePaddingOption).toUInt(&valid);
+
+                if (!valid || padding > m_const->NAME_PADDING_MAX) {
+                    cout << "ERROR: INVALID NAME PADDING" << endl;
+                    cout << "The name padding must be between 0 and 65536 bytes" << endl;
+                    quit();
+                    return;
+                }
+                m_crypto->setNamePadding(padding);
+            }
+
+            if (parser.isSet(chunkSizeOption)) {
+                auto valid       = false;
+                const auto kib   = parser.value(chunkSizeOption).toUInt(&valid);
+                const auto bytes = static_cast<quint64>(kib) * 1024;
+
+                if (!valid || bytes < m_const->MIN_CHUNK_SIZE || bytes > m_const->MAX_CHUNK_SIZE) {
+                    cout << "ERROR: INVALID CHUNK SIZE" << endl;
+                    cout << "The chunk size must be between 64 and 8192 KiB" << endl;
+                    quit();
+                    return;
+                }
+                m_crypto->setChunkSize(static_cast<quint32>(bytes));
+            }
+
             m_crypto->start();
             m_crypto->wait();
             quit();
@@ -87,6 +327,24 @@ void MainClass::run()
 
         if (direction == "DECRYPT") {
             m_crypto->setParam(false, list, passphrase, 1, 1, false);
+            m_crypto->setExtract(parser.value(extractOption));
+
+            if (parser.isSet(rangeOption)) {
+                const auto range  = parser.value(rangeOption).split(":");
+                auto validOffset  = false;
+                auto validLength  = false;
+                const auto offset = range.size() == 2 ? range.at(0).toLongLong(&validOffset) : 0;
+                const auto length = range.size() == 2 ? range.at(1).toLongLong(&validLength) : 0;
+
+                if (!validOffset || !validLength || offset < 0 || length <= 0 || list.size() != 1) {
+                    cout << "ERROR: INVALID RANGE" << endl;
+                    cout << "Use -r offset:length with one source, for example -r 1048576:4096" << endl;
+                    quit();
+                    return;
+                }
+                m_crypto->setRange(offset, length);
+            }
+
             m_crypto->start();
             m_crypto->wait();
             quit();
@@ -100,6 +358,95 @@ void MainClass::run()
 
     quit();
 }
+void MainClass::calibrate(const QString &target, const QString &maxMemory, quint32 lanes)
+{
+    auto validTarget    = false;
+    auto validMemory    = true;
+    const auto targetMs = target.toUInt(&validTarget);
+    const auto memory   = maxMemory.isEmpty() ? m_const->MEMLIMIT_CALIBRATION_MAX / 1024 : maxMemory.toUInt(&validMemory);
+
+    if (!validTarget || targetMs == 0 || !validMemory || memory < m_const->MEMLIMIT_INTERACTIVE / 1024 || memory > m_const->MEMLIMIT_CALIBRATION_MAX / 1024) {
+        cerr << "ERROR: INVALID CALIBRATION" << endl;
+        cerr << "Use --calibrate <ms> [--max-memory <MiB>], with 64 <= MiB <= 4096" << endl;
+        return;
+    }
+
+    ArgonCalibration calibration(targetMs);
+    calibration.setMaxMemlimit(memory * 1024);
+    calibration.setParallelism(lanes);
+    calibration.setProgressCallback([](const ArgonParams &params) {
+        cerr << params.memlimit / 1024 << " MiB, " << params.iterations << " iterations, " << params.parallelism << " lanes: " << params.milliseconds << " ms" << endl;
+    });
+    const auto result = calibration.calibrate();
+
+    // what to give to ENCRYPT for these parameters
+    cerr << "--memlimit " << result.memlimit / 1024 << " --iterations " << result.iterations << " --lanes " << result.parallelism << endl;
+
+    cout << QJsonDocument(calibration.toJson()).toJson().toStdString();
+}
+
+bool MainClass::stream(const QString &direction, const QString &passphrase, const ArgonParams &argon, bool compress)
+{
+    m_streaming = true;
+
+    if (direction != "ENCRYPT" && direction != "DECRYPT") {
+        cerr << "ERROR: INVALID DIRECTION" << endl;
+        cerr << "You must choose encryption OR decryption" << endl;
+        cerr << "with -d ENCRYPT or -d DECRYPT" << endl;
+        return (false);
+    }
+
+    if (passphrase.size() < m_const->MIN_PASS_LENGTH) {
+        cerr << "Passphrase must be minimum 8 characters" << endl;
+        return (false);
+    }
+
+    QFile src;
+    QFile des;
+    if (!src.open(stdin, QIODevice::ReadOnly) || !des.open(stdout, QIODevice::WriteOnly)) {
+        cerr << "ERROR: cannot open stdin or stdout" << endl;
+        return (false);
+    }
+
+    const auto encryption = direction == "ENCRYPT";
+    m_crypto->setParam(encryption, QStringList(), passphrase, 1, 1, false);
+    m_crypto->setArgonParameters(argon.memlimit, argon.iterations, argon.parallelism);
+    m_crypto->setCompression(compress ? m_const->COMPRESSION_ZLIB : m_const->COMPRESSION_NONE);
+
+    // runs in this thread, the size is unknown so there is no progress bar
+    const auto result = encryption ? m_crypto->encryptStream(src, des) : m_crypto->decryptStream(src, des);
+    des.flush();
+
+    const auto success = encryption ? CRYPT_SUCCESS : DECRYPT_SUCCESS;
+    if (result != success) {
+        cerr << "ERROR: " << errorCodeToString(result).toStdString() << endl;
+        return (false);
+    }
+    return (true);
+}
+
+bool MainClass::inspect(const QStringList &sources, quint32 threads)
+{
+    // the files are inspected while the trees are still being walked
+    ChunkQueue<QString> files(m_const->WALKER_QUEUE_SIZE);
+    DirectoryWalker walker;
+    walker.setFilter([this](const QFileInfo &info) { return (info.fileName().endsWith(m_const->DEFAULT_EXTENSION)); });
+    walker.start(sources, files);
+
+    quint64 count    = 0;
+    quint64 problems = 0;
+    Inspection::inspectAll(files, threads, [&](const Inspection &inspection) {
+        cout << QJsonDocument(inspection.toJson()).toJson(QJsonDocument::Compact).toStdString() << endl;
+        ++count;
+        if (inspection.status != DECRYPT_SUCCESS || !inspection.problems.isEmpty())
+            ++problems;
+    });
+    walker.wait();
+
+    cerr << count << " files inspected, " << problems << " with problems" << endl;
+    return (problems == 0);
+}
+
 void MainClass::greetings()
 {
     string breakLine = "############################################\n";
@@ -128,7 +475,10 @@ void MainClass::aboutToQuitApp()
 
 void MainClass::onMessageChanged(QString message)
 {
-    cout << message.toStdString() << endl;
+    if (m_streaming)
+        cerr << message.toStdString() << endl;
+    else
+        cout << message.toStdString() << endl;
 }
 void MainClass::displayProgress(const QString &path, quint32 percent)
 {
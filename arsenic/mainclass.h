@@ -5,6 +5,7 @@
 #include <QCommandLineParser>
 #include <memory>
 #include "CryptoThread.h"
+#include "argoncalibration.h"
 #include "consts.h"
 #include "tqdm.h"
 
@@ -17,6 +18,7 @@ class MainClass : public QObject {
     std::unique_ptr<Crypto_Thread> m_crypto = std::make_unique<Crypto_Thread>();
     std::unique_ptr<consts> m_const         = std::make_unique<consts>();
     tqdm bar;
+    bool m_streaming = false; // stdout carries the data, messages go to stderr
 
   public:
     explicit MainClass(QObject *parent = 0);
@@ -38,6 +40,11 @@ class MainClass : public QObject {
     /////////////////////////////////////////////////////////////
     void run();
     void greetings();
+    // lanes = 0 lets the calibration pick them
+    void calibrate(const QString &target, const QString &maxMemory, quint32 lanes);
+    // false if a file has a problem
+    bool inspect(const QStringList &sources, quint32 threads);
+    bool stream(const QString &direction, const QString &passphrase, const ArgonParams &argon, bool compress);
     void onMessageChanged(const QString message);
     void displayProgress(const QString &path, quint32 percent);
 
@@ -62,6 +62,9 @@ static const QHash<Config::ConfigKey, ConfigDirective> configStrings = {
 
     {Config::CRYPTO_argonMemory, {QS("CRYPTO/argonMemory"), Roaming, 0}},
     {Config::CRYPTO_argonItr, {QS("CRYPTO/argonItr"), Roaming, 0}},
+    {Config::CRYPTO_argonCalibratedMemory, {QS("CRYPTO/argonCalibratedMemory"), Roaming, 0}},
+    {Config::CRYPTO_argonCalibratedItr, {QS("CRYPTO/argonCalibratedItr"), Roaming, 0}},
+    {Config::CRYPTO_argonCalibratedLanes, {QS("CRYPTO/argonCalibratedLanes"), Roaming, 0}},
 
     {Config::SECURITY_clearclipboard, {QS("SECURITY/clearclipboard"), Roaming, true}},
     {Config::SECURITY_clearclipboardtimeout, {QS("SECURITY/clearclipboardtimeout"), Roaming, 10}},
@@ -45,6 +45,9 @@ class Config : public QObject {
 
         CRYPTO_argonMemory,
         CRYPTO_argonItr,
+        CRYPTO_argonCalibratedMemory,
+        CRYPTO_argonCalibratedItr,
+        CRYPTO_argonCalibratedLanes,
 
         SECURITY_clearclipboard,
         SECURITY_clearclipboardtimeout,
@@ -1,11 +1,98 @@
 #include "argonTests.h"
 #include "ui_argonTests.h"
 
+#include <QJsonDocument>
+
+#include "Config.h"
+
+CalibrationThread::CalibrationThread(quint32 targetMs, quint32 maxMemlimit, QObject *parent)
+    : QThread(parent)
+    , m_calibration(targetMs)
+{
+    m_calibration.setMaxMemlimit(maxMemlimit);
+    m_calibration.setProgressCallback([this](const ArgonParams &params) {
+        emit measured(params.memlimit, params.iterations, params.parallelism, params.milliseconds);
+    });
+}
+
+ArgonParams CalibrationThread::result() const
+{
+    return (m_result);
+}
+
+QJsonObject CalibrationThread::toJson() const
+{
+    return (m_calibration.toJson());
+}
+
+void CalibrationThread::run()
+{
+    m_result = m_calibration.calibrate();
+}
+
 ArgonTests::ArgonTests(QWidget *parent)
     : QDialog(parent)
     , m_ui(new Ui::ArgonTests)
 {
     m_ui->setupUi(this);
+
+    connect(m_ui->calibrateButton, &QPushButton::clicked, this, &ArgonTests::calibrate);
+    connect(m_ui->buttonBox->button(QDialogButtonBox::Apply), &QPushButton::clicked, this, &ArgonTests::apply);
+    m_ui->buttonBox->button(QDialogButtonBox::Apply)->setDisabled(true);
 }
 
-ArgonTests::~ArgonTests() {}
+ArgonTests::~ArgonTests()
+{
+    // a derivation can't be interrupted
+    if (m_calibration)
+        m_calibration->wait();
+}
+
+void ArgonTests::reject()
+{
+    if (m_calibration && m_calibration->isRunning())
+        return;
+    QDialog::reject();
+}
+
+void ArgonTests::calibrate()
+{
+    if (m_calibration && m_calibration->isRunning())
+        return;
+
+    m_ui->calibrateButton->setDisabled(true);
+    m_ui->buttonBox->setDisabled(true);
+    m_ui->jsonEdit->clear();
+
+    m_calibration = std::make_unique<CalibrationThread>(m_ui->spinTarget->value(), m_ui->spinMaxMemory->value() * 1024);
+    connect(m_calibration.get(), &CalibrationThread::measured, this, [=](quint32 memlimit, quint32 iterations, quint32 lanes, qint64 milliseconds) {
+        m_ui->jsonEdit->appendPlainText(tr("%1 MiB, %2 iterations, %3 lanes: %4 ms").arg(memlimit / 1024).arg(iterations).arg(lanes).arg(milliseconds));
+    });
+    connect(m_calibration.get(), &QThread::finished, this, &ArgonTests::showResult);
+    m_calibration->start();
+}
+
+void ArgonTests::showResult()
+{
+    const auto result = m_calibration->result();
+    m_ui->lineMemory->setText(tr("%1 MiB").arg(result.memlimit / 1024));
+    m_ui->lineIterations->setText(QString::number(result.iterations));
+    m_ui->lineParallelism->setText(QString::number(result.parallelism));
+    m_ui->lineTime->setText(tr("%1 ms").arg(result.milliseconds));
+    m_ui->jsonEdit->setPlainText(QJsonDocument(m_calibration->toJson()).toJson());
+
+    m_ui->calibrateButton->setDisabled(false);
+    m_ui->buttonBox->setDisabled(false);
+    m_ui->buttonBox->button(QDialogButtonBox::Apply)->setDisabled(false);
+}
+
+void ArgonTests::apply()
+{
+    const auto result = m_calibration->result();
+    config()->set(Config::CRYPTO_argonCalibratedMemory, result.memlimit);
+    config()->set(Config::CRYPTO_argonCalibratedItr, result.iterations);
+    config()->set(Config::CRYPTO_argonCalibratedLanes, result.parallelism);
+
+    m_ui->jsonEdit->appendPlainText(tr("Applied: the next files are encrypted with these parameters."));
+    m_ui->buttonBox->button(QDialogButtonBox::Apply)->setDisabled(true);
+}
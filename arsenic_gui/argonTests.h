@@ -1,12 +1,39 @@
 #pragma once
 
 #include <QDialog>
+#include <QJsonObject>
+#include <QThread>
 #include <memory>
 
+#include "argoncalibration.h"
+
 namespace Ui {
 class ArgonTests;
 }
 
+// ArgonCalibration away from the GUI thread, as Crypto_Thread runs the jobs:
+// every measure is reported by a signal. The lanes are picked too.
+class CalibrationThread : public QThread {
+    Q_OBJECT
+
+  public:
+    CalibrationThread(quint32 targetMs, quint32 maxMemlimit, QObject* parent = nullptr);
+
+    // valid once the thread is finished
+    ArgonParams result() const;
+    QJsonObject toJson() const;
+
+  signals:
+    void measured(quint32 memlimit, quint32 iterations, quint32 lanes, qint64 milliseconds);
+
+  protected:
+    void run() override;
+
+  private:
+    ArgonCalibration m_calibration;
+    ArgonParams m_result;
+};
+
 class ArgonTests : public QDialog {
     Q_OBJECT
 
@@ -14,6 +41,18 @@ class ArgonTests : public QDialog {
     explicit ArgonTests(QWidget* parent = nullptr);
     ~ArgonTests();
 
+  public slots:
+    // the dialog stays open while a calibration runs
+    void reject() override;
+
+  private slots:
+    void calibrate();
+    void showResult();
+    // the result is used by the next encryptions, until a preset is
+    // chosen again in the settings
+    void apply();
+
   private:
     const std::unique_ptr<Ui::ArgonTests> m_ui;
+    std::unique_ptr<CalibrationThread> m_calibration;
 };
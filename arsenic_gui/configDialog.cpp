@@ -45,6 +45,10 @@ void ConfigDialog::loadSettings()
 
 void ConfigDialog::saveSettings()
 {
+    // a preset chosen again replaces the calibrated parameters
+    if (m_ui->comboMemory->currentIndex() != config()->get(Config::CRYPTO_argonMemory).toInt() ||
+        m_ui->comboOps->currentIndex() != config()->get(Config::CRYPTO_argonItr).toInt())
+        config()->set(Config::CRYPTO_argonCalibratedMemory, 0);
     config()->set(Config::CRYPTO_argonMemory, m_ui->comboMemory->currentIndex());
     config()->set(Config::CRYPTO_argonItr, m_ui->comboOps->currentIndex());
     config()->set(Config::SECURITY_clearclipboardtimeout, m_ui->spinBox_clip->value());
@@ -18,6 +18,7 @@
 #include "Delegate.h"
 #include "configDialog.h"
 #include "messages.h"
+#include "directorywalker.h"
 #include "passwordGeneratorDialog.h"
 #include "hashcheckdialog.h"
 #include "utils.h"
@@ -155,7 +156,9 @@ void MainWindow::removeDeletedFile(QString filepath)
 {
     QList<QStandardItem *> items;
     QStandardItem *item;
-    items      = fileListModelCrypto->findItems(filepath, Qt::MatchExactly, 2);
+    items = fileListModelCrypto->findItems(filepath, Qt::MatchExactly, 2);
+    if (items.isEmpty()) // a file found in a directory of the list
+        return;
     item       = items[0];
     auto index = item->row();
     if (fileListModelCrypto->hasChildren()) {
@@ -220,6 +223,15 @@ void MainWindow::encryptFiles()
                             config()->get(Config::CRYPTO_argonItr).toInt(),
                             m_ui->CheckDeleteFiles->isChecked());
 
+    // the parameters applied from the Argon2 test dialog go before the presets
+    const auto calibrated = config()->get(Config::CRYPTO_argonCalibratedMemory).toUInt();
+    if (calibrated == 0 || !m_file_crypto->setArgonParameters(calibrated,
+                                                              config()->get(Config::CRYPTO_argonCalibratedItr).toUInt(),
+                                                              config()->get(Config::CRYPTO_argonCalibratedLanes).toUInt()))
+        m_file_crypto->setParallelism(m_const->PARALLELISM_DEFAULT);
+
+    // one Argon2 run for the whole list, or for the files of a directory
+    m_file_crypto->setBatchMode(getListFiles().size() > 1 || DirectoryWalker::hasDirectory(getListFiles()));
     m_file_crypto->start();
 }
 
@@ -0,0 +1,27 @@
+include(../defaults.pri)
+
+QT += core
+QT -= gui
+
+CONFIG += console
+CONFIG -= app_bundle
+TARGET = benchmarks
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+win32-g++ {
+    QMAKE_CXXFLAGS += -Wa,-mbig-obj
+}
+
+# core
+LIBS += -L$$OUT_PWD/../arscore/build/ -larscore
+INCLUDEPATH += $$PWD/../arscore
+DEPENDPATH += $$PWD/../arscore
+
+# Botan
+LIBS += -L$$OUT_PWD/../3rdparty/botan/build/ -lbotan-2
+INCLUDEPATH += $$OUT_PWD/../3rdparty/botan/build
+DEPENDPATH += $$OUT_PWD/../3rdparty/botan/build
+
+SOURCES += \
+    main.cpp
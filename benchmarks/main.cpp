@@ -0,0 +1,415 @@
+/* Throughput benchmarks for CryptoEngine and ChunkPipeline.
+ *
+ * Measures each cipher layer alone, the full cascade for every chunk size,
+ * the hand-off of chunk descriptors between the pipeline threads, and whole
+ * files (encryption and decryption through the chunk pipeline) for several
+ * file sizes, directories and thread counts. Results are printed as JSON so
+ * they can be compared from one release to the next.
+ *
+ * benchmarks [--dir <path>]... [--max-size <MiB>] [--threads 1,2,4]
+ *            [--min-time <seconds>] [--output <file.json>]
+ */
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QThread>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#endif
+
+#include "botan_all.h"
+#include "chunkpipeline.h"
+#include "consts.h"
+#include "cryptoengine.h"
+#include "messages.h"
+#include "ringqueue.h"
+
+using namespace Botan;
+
+namespace {
+
+double g_minSeconds = 1.0;
+
+quint64 cycleCounter()
+{
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+    return (__rdtsc());
+#else
+    return (0); // no portable cycle counter, cycles_per_byte is reported as 0
+#endif
+}
+
+// Run fn (which processes bytes bytes) until g_minSeconds have elapsed.
+QJsonObject measure(qint64 bytes, const std::function<void()> &fn)
+{
+    QElapsedTimer timer;
+    quint64 iterations = 0;
+    const auto startCycles = cycleCounter();
+    timer.start();
+    do {
+        fn();
+        ++iterations;
+    } while (timer.nsecsElapsed() < g_minSeconds * 1e9);
+
+    const auto seconds = timer.nsecsElapsed() / 1e9;
+    const auto cycles  = cycleCounter() - startCycles;
+    const auto total   = static_cast<double>(bytes) * iterations;
+
+    QJsonObject result;
+    result["bytes"]           = bytes;
+    result["iterations"]      = static_cast<qint64>(iterations);
+    result["seconds"]         = seconds;
+    result["mb_per_s"]        = total / seconds / 1e6;
+    result["cycles_per_byte"] = total > 0 ? cycles / total : 0.;
+    return (result);
+}
+
+QJsonArray benchLayers()
+{
+    const char *layers[] = {"ChaCha20Poly1305", "AES-256/EAX", "Serpent/GCM"};
+    const auto size      = consts::IN_BUFFER_SIZE * 16;
+    AutoSeeded_RNG rng;
+    const auto key   = rng.random_vec(consts::CIPHER_KEY_LEN);
+    const auto nonce = rng.random_vec(consts::CIPHER_IV_LEN);
+    const auto clear = rng.random_vec(size);
+
+    QJsonArray results;
+    for (const auto *name : layers) {
+        auto mode = AEAD_Mode::create(name, ENCRYPTION);
+        mode->set_key(key.data(), key.size());
+
+        SecureVector<quint8> buffer;
+        buffer.reserve(size + consts::MACBYTES);
+        auto result = measure(size, [&] {
+            buffer.assign(clear.begin(), clear.end());
+            mode->start(nonce.data(), nonce.size());
+            mode->finish(buffer);
+        });
+        result["layer"] = name;
+        results.append(result);
+    }
+    return (results);
+}
+
+QJsonArray benchCascade()
+{
+    AutoSeeded_RNG rng;
+    const auto key   = rng.random_vec(consts::CIPHER_KEY_LEN * 3);
+    const auto nonce = rng.random_vec(consts::CIPHER_IV_LEN * 3);
+
+    QJsonArray results;
+    for (auto chunkSize = consts::MIN_CHUNK_SIZE; chunkSize <= consts::MAX_CHUNK_SIZE; chunkSize *= 2) {
+        const auto clear = rng.random_vec(chunkSize);
+        for (const auto direction : {true, false}) {
+            CryptoEngine engine(direction);
+            engine.setKey(key);
+            engine.setNonce(nonce);
+
+            // decryption needs a real ciphertext
+            auto input = clear;
+            if (!direction) {
+                CryptoEngine encrypt(true);
+                encrypt.setKey(key);
+                encrypt.setNonce(nonce);
+                encrypt.finish(input);
+            }
+
+            SecureVector<quint8> buffer;
+            buffer.reserve(chunkSize + consts::MACBYTES * 3);
+            auto result = measure(chunkSize, [&] {
+                buffer.assign(input.begin(), input.end());
+                engine.setChunkIndex(0);
+                engine.finish(buffer);
+            });
+            result["chunk_size"] = static_cast<qint64>(chunkSize);
+            result["direction"]  = direction ? "encrypt" : "decrypt";
+            results.append(result);
+        }
+    }
+    return (results);
+}
+
+// the mutex and condition variables queue ChunkQueue used to be, for reference
+template <typename T>
+class LockedQueue {
+  public:
+    explicit LockedQueue(size_t capacity)
+        : m_capacity(capacity)
+    {
+    }
+
+    bool push(T &&item)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notFull.wait(lock, [this] { return m_closed || m_items.size() < m_capacity; });
+        if (m_closed)
+            return (false);
+        m_items.push_back(std::move(item));
+        m_notEmpty.notify_one();
+        return (true);
+    }
+
+    bool pop(T &item)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notEmpty.wait(lock, [this] { return m_closed || !m_items.empty(); });
+        if (m_items.empty())
+            return (false);
+        item = std::move(m_items.front());
+        m_items.pop_front();
+        m_notFull.notify_one();
+        return (true);
+    }
+
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_notFull.notify_all();
+        m_notEmpty.notify_all();
+    }
+
+  private:
+    size_t m_capacity;
+    std::deque<T> m_items;
+    bool m_closed = false;
+    std::mutex m_mutex;
+    std::condition_variable m_notFull;
+    std::condition_variable m_notEmpty;
+};
+
+// items chunks from one reader to consumers workers, like the work queue of
+// ChunkPipeline (4 slots per worker)
+template <typename Queue>
+void handOff(quint64 items, quint32 consumers)
+{
+    Queue queue(consumers * 4);
+    std::vector<std::thread> workers;
+    for (quint32 i = 0; i < consumers; ++i) {
+        workers.emplace_back([&queue] {
+            Chunk chunk;
+            while (queue.pop(chunk)) {
+            }
+        });
+    }
+    for (quint64 index = 0; index < items; ++index) {
+        Chunk chunk;
+        chunk.index = index;
+        queue.push(std::move(chunk));
+    }
+    queue.close();
+    for (auto &worker : workers)
+        worker.join();
+}
+
+// the same between two threads through the bare ring, spinning when it is
+// full or empty
+void handOffSpsc(quint64 items)
+{
+    SpscRing<Chunk> ring(4);
+    std::thread worker([&ring, items] {
+        Chunk chunk;
+        for (quint64 popped = 0; popped < items;) {
+            if (ring.tryPop(chunk))
+                ++popped;
+            else
+                std::this_thread::yield();
+        }
+    });
+    for (quint64 index = 0; index < items;) {
+        Chunk chunk;
+        chunk.index = index;
+        if (ring.tryPush(std::move(chunk)))
+            ++index;
+        else
+            std::this_thread::yield();
+    }
+    worker.join();
+}
+
+QJsonArray benchQueues(const QList<quint32> &threadCounts)
+{
+    const quint64 items = 100000;
+    QJsonArray results;
+    const auto report = [&](const QString &queue, quint32 consumers, const std::function<void()> &fn) {
+        // measure() counts bytes, here they are chunks
+        auto result = measure(items, fn);
+        result.remove("bytes");
+        result.remove("mb_per_s");
+        result["items"]           = static_cast<qint64>(items);
+        result["items_per_s"]     = items * result["iterations"].toDouble() / result["seconds"].toDouble();
+        result["cycles_per_item"] = result.take("cycles_per_byte");
+        result["queue"]           = queue;
+        result["consumers"]       = static_cast<qint64>(consumers);
+        results.append(result);
+    };
+
+    report("spsc_ring", 1, [&] { handOffSpsc(items); });
+    for (const auto threads : threadCounts) {
+        report("chunk_queue", threads, [&] { handOff<ChunkQueue<Chunk>>(items, threads); });
+        report("locked_queue", threads, [&] { handOff<LockedQueue<Chunk>>(items, threads); });
+    }
+    return (results);
+}
+
+bool writeRandomFile(const QString &path, qint64 size)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return (false);
+
+    AutoSeeded_RNG rng;
+    const auto block = rng.random_vec(consts::MAX_CHUNK_SIZE);
+    for (qint64 written = 0; written < size;) {
+        const auto len = qMin<qint64>(block.size(), size - written);
+        if (file.write(reinterpret_cast<const char *>(block.data()), len) != len)
+            return (false);
+        written += len;
+    }
+    return (true);
+}
+
+// one pass of the chunk pipeline from src_path to des_path
+quint32 runPipeline(bool direction, const QString &src_path, const QString &des_path, const SecureVector<quint8> &key,
+                    const SecureVector<quint8> &nonce, quint32 chunkSize, quint32 threads)
+{
+    QFile src(src_path);
+    QFile des(des_path);
+    if (!src.open(QIODevice::ReadOnly) || !des.open(QIODevice::WriteOnly))
+        return (direction ? SRC_CANNOT_OPEN_READ : DES_CANNOT_OPEN_WRITE);
+
+    ChunkPipeline pipeline(direction, key, threads);
+    pipeline.setChunkSize(chunkSize);
+    return (pipeline.run(src, des, nonce));
+}
+
+QJsonArray benchFiles(const QStringList &dirs, qint64 maxSize, const QList<quint32> &threadCounts)
+{
+    AutoSeeded_RNG rng;
+    const auto key   = rng.random_vec(consts::CIPHER_KEY_LEN * 3);
+    const auto nonce = rng.random_vec(consts::CIPHER_IV_LEN * 3);
+
+    QJsonArray results;
+    for (const auto &dir : dirs) {
+        for (qint64 size = 1024; size <= maxSize; size *= 10) {
+            const auto clear_path     = QDir(dir).filePath("arsenic_bench.bin");
+            const auto encrypted_path = clear_path + consts::DEFAULT_EXTENSION;
+            const auto decrypted_path = clear_path + ".out";
+            if (!writeRandomFile(clear_path, size)) {
+                std::cerr << "cannot write in " << dir.toStdString() << std::endl;
+                break;
+            }
+
+            const auto chunkSize = ChunkPipeline::adaptiveChunkSize(size);
+            for (const auto threads : threadCounts) {
+                for (const auto direction : {true, false}) {
+                    const auto &src       = direction ? clear_path : encrypted_path;
+                    const auto &des       = direction ? encrypted_path : decrypted_path;
+                    const quint32 success = direction ? CRYPT_SUCCESS : DECRYPT_SUCCESS;
+                    auto status           = success;
+                    auto result           = measure(size, [&] {
+                        const auto done = runPipeline(direction, src, des, key, nonce, chunkSize, threads);
+                        if (done != success)
+                            status = done;
+                    });
+                    // a failed run is no throughput
+                    if (status != success) {
+                        result["mb_per_s"]        = 0;
+                        result["cycles_per_byte"] = 0;
+                        result["error"]           = errorCodeToString(status);
+                        std::cerr << "failed: " << errorCodeToString(status).toStdString() << std::endl;
+                    }
+                    result["directory"]  = dir;
+                    result["file_size"]  = size;
+                    result["chunk_size"] = static_cast<qint64>(chunkSize);
+                    result["threads"]    = static_cast<qint64>(threads);
+                    result["direction"]  = direction ? "encrypt" : "decrypt";
+                    results.append(result);
+                }
+            }
+
+            QFile::remove(clear_path);
+            QFile::remove(encrypted_path);
+            QFile::remove(decrypted_path);
+        }
+    }
+    return (results);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("benchmarks");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Arsenic throughput benchmarks, results in JSON.");
+    parser.addHelpOption();
+    QCommandLineOption dirOption("dir", "Directory for the file benchmarks, can be repeated (e.g. a tmpfs and a disk).", "path");
+    QCommandLineOption maxSizeOption("max-size", "Largest file size in MiB, files go from 1 KB up to it by factors of 10 (default 1024).", "MiB", "1024");
+    QCommandLineOption threadsOption("threads", "Comma separated worker counts (default 1,2,4 and one per core).", "list");
+    QCommandLineOption minTimeOption("min-time", "Minimum duration of every measure in seconds (default 1).", "seconds", "1");
+    QCommandLineOption outputOption("output", "Write the JSON to this file instead of stdout.", "file");
+    parser.addOption(dirOption);
+    parser.addOption(maxSizeOption);
+    parser.addOption(threadsOption);
+    parser.addOption(minTimeOption);
+    parser.addOption(outputOption);
+    parser.process(app);
+
+    g_minSeconds = qMax(0.01, parser.value(minTimeOption).toDouble());
+
+    auto dirs = parser.values(dirOption);
+    if (dirs.isEmpty())
+        dirs << QDir::tempPath();
+
+    QList<quint32> threadCounts;
+    if (parser.isSet(threadsOption)) {
+        for (const auto &count : parser.value(threadsOption).split(","))
+            threadCounts << qMax(1u, count.toUInt());
+    }
+    else {
+        threadCounts << 1 << 2 << 4;
+        const auto cores = static_cast<quint32>(QThread::idealThreadCount());
+        if (cores > 4)
+            threadCounts << cores;
+    }
+
+    QJsonObject report;
+    report["arsenic_version"] = consts::APP_VERSION.toString();
+    report["botan_version"]   = consts::BOTAN_VERSION;
+    report["cpu_threads"]     = QThread::idealThreadCount();
+    report["layers"]          = benchLayers();
+    report["cascade"]         = benchCascade();
+    report["queues"]          = benchQueues(threadCounts);
+    report["files"]           = benchFiles(dirs, parser.value(maxSizeOption).toLongLong() * 1024 * 1024, threadCounts);
+
+    const auto json = QJsonDocument(report).toJson(QJsonDocument::Indented);
+    if (parser.isSet(outputOption)) {
+        QFile output(parser.value(outputOption));
+        if (!output.open(QIODevice::WriteOnly) || output.write(json) != json.size()) {
+            std::cerr << "cannot write " << parser.value(outputOption).toStdString() << std::endl;
+            return (1);
+        }
+    }
+    else {
+        std::cout << json.toStdString() << std::endl;
+    }
+    return (0);
+}
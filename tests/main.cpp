@@ -1,11 +1,27 @@
 #define CATCH_CONFIG_RUNNER
 #include <QCoreApplication>
 //#include <QDebug>
+#include <QBuffer>
 #include <QDataStream>
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
+#include <QMap>
 #include "consts.h"
 #include "CryptoThread.h"
+#include "argon2id.h"
+#include "argoncalibration.h"
+#include "chunkpipeline.h"
+#include "cryptoengine.h"
+#include "directfile.h"
+#include "fileheader.h"
+#include "inspection.h"
+#include "ioengine.h"
+#include "jobscheduler.h"
+#include "journal.h"
+#include "keycache.h"
+#include "messages.h"
+#include "ringqueue.h"
 #include "textcrypto.h"
 #include "utils.h"
 #include "catch/catch.hpp"
@@ -103,6 +119,1302 @@ bool encryptFile()
     return (result1 == result2);
 }
 
+bool parallelMatchesSerial()
+{
+    // 5 full chunks and a short one
+    Botan::AutoSeeded_RNG rng;
+    const auto key         = rng.random_vec(consts::CIPHER_KEY_LEN * 3);
+    const auto tripleNonce = rng.random_vec(consts::CIPHER_IV_LEN * 3);
+    const auto clear       = rng.random_vec(consts::IN_BUFFER_SIZE * 5 + 1234);
+
+    // the serial loop, as Crypto_Thread used to do it
+    CryptoEngine serial(true);
+    serial.setKey(key);
+    serial.setNonce(tripleNonce);
+    QByteArray expected;
+    for (size_t pos = 0; pos < clear.size(); pos += consts::IN_BUFFER_SIZE) {
+        const auto len = std::min<size_t>(consts::IN_BUFFER_SIZE, clear.size() - pos);
+        Botan::SecureVector<quint8> chunk(clear.begin() + pos, clear.begin() + pos + len);
+        serial.finish(chunk);
+        expected.append(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+    }
+
+    QByteArray input(reinterpret_cast<const char*>(clear.data()), clear.size());
+    QByteArray output;
+    QBuffer src(&input);
+    QBuffer des(&output);
+    src.open(QIODevice::ReadOnly);
+    des.open(QIODevice::WriteOnly);
+
+    ChunkPipeline pipeline(true, key, 4);
+    if (pipeline.run(src, des, tripleNonce, 0) != CRYPT_SUCCESS)
+        return (false);
+
+    // the pool holds 4 buffers per worker and none of them had to grow
+    return (output == expected && pipeline.poolBuffers() == 16);
+}
+
+bool parallelDecryption()
+{
+    Botan::AutoSeeded_RNG rng;
+    const auto key         = rng.random_vec(consts::CIPHER_KEY_LEN * 3);
+    const auto tripleNonce = rng.random_vec(consts::CIPHER_IV_LEN * 3);
+    const auto clear       = rng.random_vec(consts::IN_BUFFER_SIZE * 7 + 99);
+
+    QByteArray input(reinterpret_cast<const char*>(clear.data()), clear.size());
+    QByteArray encrypted;
+    QBuffer src(&input);
+    QBuffer des(&encrypted);
+    src.open(QIODevice::ReadOnly);
+    des.open(QIODevice::WriteOnly);
+    ChunkPipeline encryption(true, key, 3);
+    if (encryption.run(src, des, tripleNonce) != CRYPT_SUCCESS)
+        return (false);
+
+    QByteArray decrypted;
+    QBuffer src2(&encrypted);
+    QBuffer des2(&decrypted);
+    src2.open(QIODevice::ReadOnly);
+    des2.open(QIODevice::WriteOnly);
+    ChunkPipeline decryption(false, key, 3);
+    if (decryption.run(src2, des2, tripleNonce) != DECRYPT_SUCCESS || decrypted != input)
+        return (false);
+
+    // flip one bit in the fifth chunk: decryption must fail
+    encrypted[(consts::IN_BUFFER_SIZE + consts::MACBYTES * 3) * 4 + 10] ^= 1;
+    QByteArray tampered;
+    QBuffer src3(&encrypted);
+    QBuffer des3(&tampered);
+    src3.open(QIODevice::ReadOnly);
+    des3.open(QIODevice::WriteOnly);
+    ChunkPipeline corrupted(false, key, 3);
+    return (corrupted.run(src3, des3, tripleNonce) == DECRYPT_FAIL);
+}
+
+bool seekMatchesReplay()
+{
+    Botan::AutoSeeded_RNG rng;
+    const auto key   = rng.random_vec(consts::CIPHER_KEY_LEN * 3);
+    // all 0xff so the seek has to carry over every byte of the counters
+    const Botan::SecureVector<quint8> tripleNonce(consts::CIPHER_IV_LEN * 3, 0xff);
+    const auto clear = rng.random_vec(1000);
+
+    CryptoEngine replay(true);
+    replay.setKey(key);
+    replay.setNonce(tripleNonce);
+    Botan::SecureVector<quint8> expected;
+    for (auto i = 0; i < 300; ++i) {
+        expected = clear;
+        replay.finish(expected);
+    }
+
+    CryptoEngine seek(true);
+    seek.setKey(key);
+    seek.setNonce(tripleNonce);
+    seek.setChunkIndex(299);
+    auto buffer = clear;
+    seek.finish(buffer);
+
+    return (buffer == expected && seek.chunkIndex() == 300);
+}
+
+bool decryptRange()
+{
+    // 3 chunks and a half, the range starts in the first and ends in the third
+    Botan::AutoSeeded_RNG rng;
+    const auto clear    = rng.random_vec(consts::IN_BUFFER_SIZE * 3 + consts::IN_BUFFER_SIZE / 2);
+    const qint64 offset = consts::IN_BUFFER_SIZE - 100;
+    const qint64 length = consts::IN_BUFFER_SIZE + 300;
+
+    QFile::remove(QDir::cleanPath("range.bin"));
+    QFile::remove(QDir::cleanPath("range.bin.arsn"));
+    const auto rangeName = QString("range.bin.%1-%2").arg(offset).arg(offset + length);
+    QFile::remove(QDir::cleanPath(rangeName));
+
+    QFile src_file(QDir::cleanPath("range.bin"));
+    src_file.open(QIODevice::WriteOnly);
+    src_file.write(reinterpret_cast<const char*>(clear.data()), clear.size());
+    src_file.close();
+
+    Crypto_Thread Crypto;
+    Crypto.setParam(true, QStringList() << "range.bin", "mypassword", 0, 0, false);
+    Crypto.start();
+    Crypto.wait();
+
+    Crypto.setParam(false, QStringList() << "range.bin.arsn", "mypassword", 0, 0, false);
+    Crypto.setRange(offset, length);
+    Crypto.start();
+    Crypto.wait();
+
+    QFile des_file(QDir::cleanPath(rangeName));
+    if (!des_file.open(QIODevice::ReadOnly))
+        return (false);
+
+    const auto extract = des_file.readAll();
+    return (extract == QByteArray(reinterpret_cast<const char*>(clear.data()) + offset, length));
+}
+
+bool batchEncryption()
+{
+    // three files, one Argon2 run to encrypt them, and the decryption
+    // finds the same key in the cache
+    Botan::AutoSeeded_RNG rng;
+    QStringList clear_names;
+    QStringList encrypted_names;
+    QList<QByteArray> contents;
+    for (auto i = 0; i < 3; ++i) {
+        const auto name = QString("batch%1.bin").arg(i);
+        const auto data = rng.random_vec(1000 + i * consts::IN_BUFFER_SIZE);
+        contents.append(QByteArray(reinterpret_cast<const char*>(data.data()), data.size()));
+        QFile::remove(QDir::cleanPath(name + consts::DEFAULT_EXTENSION));
+
+        QFile file(QDir::cleanPath(name));
+        file.open(QIODevice::WriteOnly);
+        file.write(contents.last());
+        clear_names << name;
+        encrypted_names << name + consts::DEFAULT_EXTENSION;
+    }
+
+    Crypto_Thread Crypto;
+    Crypto.setParam(true, clear_names, "mypassword", 0, 0, true);
+    Crypto.setBatchMode(true);
+    Crypto.start();
+    Crypto.wait();
+    if (Crypto.derivations() != 1)
+        return (false);
+
+    Crypto.setParam(false, encrypted_names, "mypassword", 0, 0, true);
+    Crypto.start();
+    Crypto.wait();
+    if (Crypto.derivations() != 0)
+        return (false);
+
+    for (auto i = 0; i < 3; ++i) {
+        QFile file(QDir::cleanPath(clear_names.at(i)));
+        if (!file.open(QIODevice::ReadOnly) || file.readAll() != contents.at(i))
+            return (false);
+    }
+    return (true);
+}
+
+bool storedArgonParameters()
+{
+    // encrypted with the interactive preset, decrypted with another one
+    Botan::AutoSeeded_RNG rng;
+    const auto data = rng.random_vec(5000);
+    const QByteArray input(reinterpret_cast<const char*>(data.data()), data.size());
+
+    QFile::remove("argon.bin.arsn");
+    QFile file("argon.bin");
+    file.open(QIODevice::WriteOnly);
+    file.write(input);
+    file.close();
+
+    Crypto_Thread Crypto;
+    Crypto.setParam(true, QStringList{"argon.bin"}, "mypassword", 0, 0, true);
+    Crypto.start();
+    Crypto.wait();
+
+    // preview, then extract: Argon2 runs for the first one only. The
+    // outputs are kept until the end so every one gets the next name.
+    QFile::remove("argon (2).bin");
+    QFile::remove("argon (3).bin");
+    QStringList decrypted{"argon.bin", "argon (2).bin", "argon (3).bin"};
+    const quint64 derivations[] = {1, 0, 1};
+    for (auto i = 0; i < 3; ++i) {
+        if (i == 2)
+            Crypto.clearKeys();
+        Crypto.setParam(false, QStringList{"argon.bin.arsn"}, "mypassword", 2, 2, false);
+        Crypto.start();
+        Crypto.wait();
+
+        QFile clear(decrypted.at(i));
+        if (Crypto.derivations() != derivations[i] || !clear.open(QIODevice::ReadOnly) || clear.readAll() != input)
+            return (false);
+    }
+    for (const auto &name : decrypted) {
+        if (!QFile::remove(name))
+            return (false);
+    }
+
+    // a new password never finds the keys of the previous one
+    Crypto.setParam(false, QStringList{"argon.bin.arsn"}, "otherpassword", 0, 0, false);
+    Crypto.start();
+    Crypto.wait();
+    return (Crypto.derivations() == 1 && !QFile::exists("argon.bin") && QFile::remove("argon.bin.arsn"));
+}
+
+bool calibratedArgonParameters()
+{
+    // only what a header may hold
+    Crypto_Thread Crypto;
+    if (Crypto.setArgonParameters(0, 1, 1) || Crypto.setArgonParameters(consts::MEMLIMIT_INTERACTIVE, 0, 1) ||
+        Crypto.setArgonParameters(consts::MEMLIMIT_INTERACTIVE, consts::ITERATION_CALIBRATION_MAX + 1, 1) ||
+        Crypto.setArgonParameters(consts::MEMLIMIT_INTERACTIVE, 1, consts::PARALLELISM_MAX + 1) || Crypto.setArgonParameters(15, 1, 2))
+        return (false);
+
+    // the lanes are picked by the calibration, from 1 to one per core
+    ArgonCalibration calibration(1);
+    const auto params = calibration.calibrate();
+    const auto cores  = static_cast<quint32>(qBound(1, QThread::idealThreadCount(), static_cast<int>(consts::PARALLELISM_MAX)));
+    if (params.parallelism < 1 || params.parallelism > cores)
+        return (false);
+
+    Botan::AutoSeeded_RNG rng;
+    const auto data = rng.random_vec(5000);
+    const QByteArray input(reinterpret_cast<const char*>(data.data()), data.size());
+    QFile file("calibrated.bin");
+    file.open(QIODevice::WriteOnly);
+    file.write(input);
+    file.close();
+
+    // and the result ends up in the header, in place of the presets
+    Crypto.setParam(true, QStringList{"calibrated.bin"}, "mypassword", 0, 0, true);
+    if (!Crypto.setArgonParameters(params.memlimit, 2, params.parallelism))
+        return (false);
+    Crypto.start();
+    Crypto.wait();
+
+    QFile arsn("calibrated.bin.arsn");
+    if (!arsn.open(QIODevice::ReadOnly))
+        return (false);
+    FileHeader header;
+    QDataStream stream(&arsn);
+    stream.setVersion(QDataStream::Qt_5_0);
+    if (header.read(stream) != DECRYPT_SUCCESS || header.memlimit != params.memlimit || header.iterations != 2 || header.parallelism != params.parallelism)
+        return (false);
+    arsn.close();
+
+    Crypto.setParam(false, QStringList{"calibrated.bin.arsn"}, "mypassword", 0, 0, true);
+    Crypto.start();
+    Crypto.wait();
+    if (QFile::exists("calibrated.bin.arsn") || !file.open(QIODevice::ReadOnly) || file.readAll() != input)
+        return (false);
+    file.close();
+    return (file.remove());
+}
+
+bool directoryEncryption()
+{
+    // a small tree, encrypted in place and decrypted back to the same paths
+    Botan::AutoSeeded_RNG rng;
+    QDir("tree").removeRecursively();
+    QDir().mkpath("tree/a/b");
+    QDir().mkpath("tree/c");
+
+    const QStringList names{"tree/root.bin", "tree/a/one.bin", "tree/a/b/two.bin", "tree/a/b/.hidden", "tree/c/three.bin"};
+    QMap<QString, QByteArray> contents;
+    for (const auto &name : names) {
+        const auto data = rng.random_vec(100 + contents.size() * consts::IN_BUFFER_SIZE);
+        contents[name]  = QByteArray(reinterpret_cast<const char*>(data.data()), data.size());
+
+        QFile file(name);
+        file.open(QIODevice::WriteOnly);
+        file.write(contents[name]);
+    }
+
+    Crypto_Thread Crypto;
+    Crypto.setParam(true, QStringList{"tree"}, "mypassword", 0, 0, true);
+    Crypto.setBatchMode(true);
+    Crypto.start();
+    Crypto.wait();
+
+    for (const auto &name : names) {
+        if (QFile::exists(name) || !QFile::exists(name + consts::DEFAULT_EXTENSION))
+            return (false);
+    }
+
+    Crypto.setParam(false, QStringList{"tree"}, "mypassword", 0, 0, true);
+    Crypto.start();
+    Crypto.wait();
+
+    for (const auto &name : names) {
+        QFile file(name);
+        if (QFile::exists(name + consts::DEFAULT_EXTENSION) || !file.open(QIODevice::ReadOnly) || file.readAll() != contents[name])
+            return (false);
+    }
+    return (QDir("tree").removeRecursively());
+}
+
+bool archiveEncryption()
+{
+    // a folder and a loose file in one archive, then one member extracted alone
+    Botan::AutoSeeded_RNG rng;
+    QDir("pack").removeRecursively();
+    QDir().mkpath("pack/sub");
+    QFile::remove("packed.arsn");
+
+    const QStringList names{"pack/a.bin", "pack/empty.bin", "pack/sub/b.bin", "loose.bin"};
+    QMap<QString, QByteArray> contents;
+    for (const auto &name : names) {
+        const auto data = rng.random_vec(name == "pack/empty.bin" ? 0 : 3000 + contents.size() * consts::IN_BUFFER_SIZE);
+        contents[name]  = QByteArray(reinterpret_cast<const char*>(data.data()), data.size());
+
+        QFile file(name);
+        file.open(QIODevice::WriteOnly);
+        file.write(contents[name]);
+    }
+
+    Crypto_Thread Crypto;
+    Crypto.setParam(true, QStringList{"pack", "loose.bin"}, "mypassword", 0, 0, true);
+    Crypto.setArchive("packed");
+    Crypto.start();
+    Crypto.wait();
+
+    for (const auto &name : names) {
+        if (QFile::exists(name))
+            return (false);
+    }
+
+    Crypto.setParam(false, QStringList{"packed.arsn"}, "mypassword", 0, 0, false);
+    Crypto.setExtract("pack/sub/b.bin");
+    Crypto.start();
+    Crypto.wait();
+
+    QFile member("pack/sub/b.bin");
+    if (!member.open(QIODevice::ReadOnly) || member.readAll() != contents["pack/sub/b.bin"] || QFile::exists("pack/a.bin"))
+        return (false);
+    member.close();
+    QDir("pack").removeRecursively();
+
+    Crypto.setParam(false, QStringList{"packed.arsn"}, "mypassword", 0, 0, true);
+    Crypto.start();
+    Crypto.wait();
+
+    for (const auto &name : names) {
+        QFile file(name);
+        if (!file.open(QIODevice::ReadOnly) || file.readAll() != contents[name])
+            return (false);
+        file.remove();
+    }
+    return (!QFile::exists("packed.arsn") && QDir("pack").removeRecursively());
+}
+
+bool nameBlockLayouts()
+{
+    // a 4.4.0 file, the name followed by 64 KiB of random data, made by hand
+    Botan::AutoSeeded_RNG rng;
+    const auto clear = rng.random_vec(5000);
+    const auto salt  = rng.random_vec(consts::ARGON_SALT_LEN);
+    const auto nonce = rng.random_vec(consts::CIPHER_IV_LEN * 3);
+    const QByteArray name("legacy.bin");
+
+    CryptoEngine engine(true);
+    engine.setSalt(salt);
+    engine.derivePassword("mypassword", consts::MEMLIMIT_INTERACTIVE, consts::ITERATION_INTERACTIVE);
+    engine.setNonce(nonce);
+
+    Botan::SecureVector<quint8> header(name.begin(), name.end());
+    const auto padding = rng.random_vec(consts::IN_BUFFER_SIZE);
+    header.insert(header.end(), padding.begin(), padding.end());
+    engine.finish(header);
+    auto data = clear;
+    engine.finish(data);
+
+    QFile::remove("legacy.bin");
+    QFile legacy("legacy.bin.arsn");
+    legacy.open(QIODevice::WriteOnly);
+    QDataStream stream(&legacy);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << consts::MAGIC_NUMBER << QVersionNumber(4, 4, 0) << consts::MEMLIMIT_INTERACTIVE << consts::ITERATION_INTERACTIVE;
+    stream << consts::IN_BUFFER_SIZE << consts::PARALLELISM_INTERACTIVE << consts::KEY_MODE_PASSWORD;
+    stream << static_cast<qint64>(name.size()) << static_cast<qint64>(clear.size());
+    stream.writeRawData(reinterpret_cast<const char*>(salt.data()), salt.size());
+    stream.writeRawData(reinterpret_cast<const char*>(nonce.data()), nonce.size());
+    stream.writeRawData(reinterpret_cast<const char*>(header.data()), header.size());
+    stream.writeRawData(reinterpret_cast<const char*>(data.data()), data.size());
+    legacy.close();
+
+    const QByteArray expected(reinterpret_cast<const char*>(clear.data()), clear.size());
+    Crypto_Thread Crypto;
+    Crypto.setParam(false, QStringList{"legacy.bin.arsn"}, "mypassword", 0, 0, true);
+    Crypto.start();
+    Crypto.wait();
+
+    QFile decrypted("legacy.bin");
+    if (!decrypted.open(QIODevice::ReadOnly) || decrypted.readAll() != expected)
+        return (false);
+    decrypted.close();
+
+    // the padded name block of a new file is 256 bytes, not 64 KiB
+    Crypto.setParam(true, QStringList{"legacy.bin"}, "mypassword", 0, 0, true);
+    Crypto.start();
+    Crypto.wait();
+    if (QFileInfo("legacy.bin.arsn").size() > static_cast<qint64>(clear.size()) + 1024)
+        return (false);
+
+    Crypto.setParam(false, QStringList{"legacy.bin.arsn"}, "mypassword", 0, 0, true);
+    Crypto.start();
+    Crypto.wait();
+
+    if (!decrypted.open(QIODevice::ReadOnly) || decrypted.readAll() != expected)
+        return (false);
+    return (decrypted.remove());
+}
+
+bool legacyHeader()
+{
+    // a 4.0.0 file: no chunk size, lanes, key mode nor name block, made by hand
+    Botan::AutoSeeded_RNG rng;
+    const auto clear = rng.random_vec(consts::IN_BUFFER_SIZE * 2 + 321);
+    const auto salt  = rng.random_vec(consts::ARGON_SALT_LEN);
+    const auto nonce = rng.random_vec(consts::CIPHER_IV_LEN * 3);
+    const QByteArray name("old.bin");
+
+    CryptoEngine engine(true);
+    engine.setSalt(salt);
+    engine.derivePassword("mypassword", consts::MEMLIMIT_INTERACTIVE, consts::ITERATION_INTERACTIVE);
+    engine.setNonce(nonce);
+
+    Botan::SecureVector<quint8> header(name.begin(), name.end());
+    const auto padding = rng.random_vec(consts::IN_BUFFER_SIZE);
+    header.insert(header.end(), padding.begin(), padding.end());
+    engine.finish(header);
+
+    QFile::remove("old.bin");
+    QFile legacy("old.bin.arsn");
+    legacy.open(QIODevice::WriteOnly);
+    QDataStream stream(&legacy);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << consts::MAGIC_NUMBER << QVersionNumber(4, 0, 0) << consts::MEMLIMIT_INTERACTIVE << consts::ITERATION_INTERACTIVE;
+    stream << static_cast<qint64>(name.size()) << static_cast<qint64>(clear.size());
+    stream.writeRawData(reinterpret_cast<const char*>(salt.data()), salt.size());
+    stream.writeRawData(reinterpret_cast<const char*>(nonce.data()), nonce.size());
+    stream.writeRawData(reinterpret_cast<const char*>(header.data()), header.size());
+    for (size_t pos = 0; pos < clear.size(); pos += consts::IN_BUFFER_SIZE) {
+        const auto len = std::min<size_t>(consts::IN_BUFFER_SIZE, clear.size() - pos);
+        Botan::SecureVector<quint8> chunk(clear.begin() + pos, clear.begin() + pos + len);
+        engine.finish(chunk);
+        stream.writeRawData(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+    }
+    legacy.close();
+
+    // the missing fields get the values 4.0.0 used
+    FileHeader fields;
+    legacy.open(QIODevice::ReadOnly);
+    QDataStream in(&legacy);
+    in.setVersion(QDataStream::Qt_5_0);
+    if (fields.read(in) != DECRYPT_SUCCESS || fields.chunkSize != consts::IN_BUFFER_SIZE || fields.parallelism != consts::PARALLELISM_INTERACTIVE
+        || fields.keyMode != consts::KEY_MODE_PASSWORD || fields.compressed() || fields.nameBlock())
+        return (false);
+    legacy.close();
+
+    Crypto_Thread Crypto;
+    Crypto.setParam(false, QStringList{"old.bin.arsn"}, "mypassword", 0, 0, true);
+    Crypto.start();
+    Crypto.wait();
+
+    const QByteArray expected(reinterpret_cast<const char*>(clear.data()), clear.size());
+    QFile decrypted("old.bin");
+    if (!decrypted.open(QIODevice::ReadOnly) || decrypted.readAll() != expected)
+        return (false);
+    return (decrypted.remove());
+}
+
+bool adaptiveChunkBounds()
+{
+    // CHUNKS_PER_FILE chunks at most, powers of two between the bounds
+    const qint64 min = consts::MIN_CHUNK_SIZE;
+    const qint64 max = consts::MAX_CHUNK_SIZE;
+    const qint64 per = consts::CHUNKS_PER_FILE;
+    if (ChunkPipeline::adaptiveChunkSize(0) != min || ChunkPipeline::adaptiveChunkSize(1) != min)
+        return (false);
+    if (ChunkPipeline::adaptiveChunkSize(min * per) != min || ChunkPipeline::adaptiveChunkSize(min * (per + 1)) != min * 2)
+        return (false);
+    if (ChunkPipeline::adaptiveChunkSize(max * per) != max || ChunkPipeline::adaptiveChunkSize(max / 2 * (per + 1)) != max)
+        return (false);
+    if (ChunkPipeline::adaptiveChunkSize(max / 2 * per) != max / 2 || ChunkPipeline::adaptiveChunkSize(qint64(1) << 50) != max)
+        return (false);
+
+    for (qint64 size = 1; size < (qint64(1) << 40); size = size * 3 + 7) {
+        const auto chunkSize = ChunkPipeline::adaptiveChunkSize(size);
+        if (chunkSize < min || chunkSize > max || (chunkSize & (chunkSize - 1)) != 0)
+            return (false);
+        if (chunkSize < max && size / chunkSize > per)
+            return (false);
+    }
+    return (true);
+}
+
+bool uniqueOutputNames()
+{
+    // two jobs writing the same original name never get the same file
+    QFile::remove("same.bin");
+    QFile::remove("same (2).bin");
+    QFile first;
+    QFile second;
+    if (!Utils::openUniqueFile(first, QDir::current().filePath("same.bin"), QIODevice::WriteOnly))
+        return (false);
+    if (!Utils::openUniqueFile(second, QDir::current().filePath("same.bin"), QIODevice::WriteOnly))
+        return (false);
+
+    const auto distinct = QFileInfo(first).fileName() == "same.bin" && QFileInfo(second).fileName() == "same (2).bin";
+    return (first.remove() && second.remove() && distinct);
+}
+
+bool streamEncryption()
+{
+    // two full chunks: the stream ends with an empty one
+    Botan::AutoSeeded_RNG rng;
+    const auto clear = rng.random_vec(consts::MIN_CHUNK_SIZE * 2);
+    QByteArray input(reinterpret_cast<const char*>(clear.data()), clear.size());
+    QByteArray encrypted;
+    QByteArray decrypted;
+
+    Crypto_Thread Crypto;
+    Crypto.setParam(true, QStringList(), "mypassword", 0, 0, false);
+    Crypto.setChunkSize(consts::MIN_CHUNK_SIZE);
+    QBuffer src(&input);
+    QBuffer des(&encrypted);
+    src.open(QIODevice::ReadOnly);
+    des.open(QIODevice::WriteOnly);
+    if (Crypto.encryptStream(src, des) != CRYPT_SUCCESS)
+        return (false);
+
+    Crypto.setParam(false, QStringList(), "mypassword", 0, 0, false);
+    QBuffer src2(&encrypted);
+    QBuffer des2(&decrypted);
+    src2.open(QIODevice::ReadOnly);
+    des2.open(QIODevice::WriteOnly);
+    if (Crypto.decryptStream(src2, des2) != DECRYPT_SUCCESS || decrypted != input)
+        return (false);
+
+    // cut after the last full chunk
+    QByteArray truncated = encrypted.left(encrypted.size() - consts::MACBYTES * 3);
+    QByteArray output;
+    QBuffer src3(&truncated);
+    QBuffer des3(&output);
+    src3.open(QIODevice::ReadOnly);
+    des3.open(QIODevice::WriteOnly);
+    if (Crypto.decryptStream(src3, des3) != DECRYPT_FAIL)
+        return (false);
+
+    // a stream saved to a file decrypts like any .arsn, named after it
+    QFile::remove("stream.bin");
+    QFile file("stream.bin.arsn");
+    file.open(QIODevice::WriteOnly);
+    file.write(encrypted);
+    file.close();
+
+    Crypto.setParam(false, QStringList{"stream.bin.arsn"}, "mypassword", 0, 0, true);
+    Crypto.start();
+    Crypto.wait();
+
+    QFile result("stream.bin");
+    if (QFile::exists("stream.bin.arsn") || !result.open(QIODevice::ReadOnly) || result.readAll() != input)
+        return (false);
+    return (result.remove());
+}
+
+bool compressedEncryption()
+{
+    // 3 chunks of text, a random chunk that doesn't compress and a half chunk
+    Botan::AutoSeeded_RNG rng;
+    QByteArray clear;
+    while (clear.size() < static_cast<int>(consts::MIN_CHUNK_SIZE * 3))
+        clear.append("2026-10-17 12:00:00 INFO request served in 12 ms\n");
+    clear.truncate(consts::MIN_CHUNK_SIZE * 3);
+    const auto noise = rng.random_vec(consts::MIN_CHUNK_SIZE + consts::MIN_CHUNK_SIZE / 2);
+    clear.append(reinterpret_cast<const char*>(noise.data()), noise.size());
+
+    QFile::remove("packed.log");
+    QFile::remove("packed.log.arsn");
+    QFile file("packed.log");
+    file.open(QIODevice::WriteOnly);
+    file.write(clear);
+    file.close();
+
+    Crypto_Thread Crypto;
+    Crypto.setParam(true, QStringList{"packed.log"}, "mypassword", 0, 0, true);
+    Crypto.setChunkSize(consts::MIN_CHUNK_SIZE);
+    Crypto.setCompression(consts::COMPRESSION_ZLIB);
+    Crypto.start();
+    Crypto.wait();
+
+    // the text shrinks, the random data costs its flag and tags only
+    if (QFileInfo("packed.log.arsn").size() > clear.size() / 2)
+        return (false);
+
+    // a range across a compressed and a stored chunk
+    const qint64 offset = consts::MIN_CHUNK_SIZE * 3 - 100;
+    const qint64 length = 300;
+    const auto rangeName = QString("packed.log.%1-%2").arg(offset).arg(offset + length);
+    Crypto.setParam(false, QStringList{"packed.log.arsn"}, "mypassword", 0, 0, false);
+    Crypto.setRange(offset, length);
+    Crypto.start();
+    Crypto.wait();
+
+    QFile range(rangeName);
+    if (!range.open(QIODevice::ReadOnly) || range.readAll() != clear.mid(offset, length))
+        return (false);
+    range.remove();
+
+    QFile encrypted("packed.log.arsn");
+    encrypted.open(QIODevice::ReadOnly);
+    const auto content = encrypted.readAll();
+    encrypted.close();
+
+    Crypto.setParam(false, QStringList{"packed.log.arsn"}, "mypassword", 0, 0, true);
+    Crypto.start();
+    Crypto.wait();
+
+    QFile decrypted("packed.log");
+    if (!decrypted.open(QIODevice::ReadOnly) || decrypted.readAll() != clear)
+        return (false);
+    decrypted.close();
+    decrypted.remove();
+
+    // without its end block the file is cut, nothing is written
+    QFile cut("packed.log.arsn");
+    cut.open(QIODevice::WriteOnly);
+    cut.write(content.left(content.size() - consts::CHUNK_LENGTH_LEN - 1 - consts::MACBYTES * 3));
+    cut.close();
+
+    Crypto.setParam(false, QStringList{"packed.log.arsn"}, "mypassword", 0, 0, true);
+    Crypto.start();
+    Crypto.wait();
+    if (QFile::exists("packed.log") || !cut.remove())
+        return (false);
+
+    // the same from a stream
+    QByteArray packed;
+    QByteArray unpacked;
+    QBuffer src(&clear);
+    QBuffer des(&packed);
+    src.open(QIODevice::ReadOnly);
+    des.open(QIODevice::WriteOnly);
+    Crypto.setParam(true, QStringList(), "mypassword", 0, 0, false);
+    if (Crypto.encryptStream(src, des) != CRYPT_SUCCESS)
+        return (false);
+
+    QBuffer src2(&packed);
+    QBuffer des2(&unpacked);
+    src2.open(QIODevice::ReadOnly);
+    des2.open(QIODevice::WriteOnly);
+    Crypto.setParam(false, QStringList(), "mypassword", 0, 0, false);
+    return (Crypto.decryptStream(src2, des2) == DECRYPT_SUCCESS && unpacked == clear);
+}
+
+bool resumeJob()
+{
+    // an interrupted run is simulated with the output and journal it leaves
+    Botan::AutoSeeded_RNG rng;
+    const auto clear = rng.random_vec(consts::MIN_CHUNK_SIZE * 5 + 1234);
+    const QByteArray input(reinterpret_cast<const char*>(clear.data()), clear.size());
+    const auto journalPath = Journal::pathFor("resume.bin.arsn");
+
+    QFile::remove("resume.bin.arsn");
+    QFile::remove(journalPath);
+    QFile file("resume.bin");
+    file.open(QIODevice::WriteOnly);
+    file.write(input);
+    file.close();
+
+    Crypto_Thread Crypto;
+    Crypto.setParam(true, QStringList{"resume.bin"}, "mypassword", 0, 0, false);
+    Crypto.setChunkSize(consts::MIN_CHUNK_SIZE);
+    Crypto.setResumable(true);
+    Crypto.start();
+    Crypto.wait();
+
+    QFile arsn("resume.bin.arsn");
+    if (QFile::exists(journalPath) || !arsn.open(QIODevice::ReadWrite))
+        return (false);
+    const auto full = arsn.readAll();
+
+    // 3 blocks made durable, half of the 4th written after the checkpoint
+    FileHeader header;
+    QDataStream stream(&arsn);
+    stream.setVersion(QDataStream::Qt_5_0);
+    arsn.seek(0);
+    if (header.read(stream) != DECRYPT_SUCCESS || !arsn.seek(arsn.pos() + header.nameBlockSize()))
+        return (false);
+    const auto dataStart = arsn.pos();
+
+    Journal journal;
+    journal.path   = journalPath;
+    journal.output = arsn.fileName();
+    journal.chunks = 3;
+    journal.setSource(QFileInfo("resume.bin"));
+    if (!ChunkPipeline::replayTags(arsn, 3, header.chunkSize, false, journal.state))
+        return (false);
+    arsn.resize(arsn.pos() + header.chunkSize / 2);
+    arsn.close();
+    journal.save();
+
+    Crypto.setParam(true, QStringList{"resume.bin"}, "mypassword", 0, 0, false);
+    Crypto.start();
+    Crypto.wait();
+
+    if (QFile::exists(journalPath) || !arsn.open(QIODevice::ReadOnly) || arsn.readAll() != full)
+        return (false);
+
+    // decryption stopped after 2 blocks, with some bytes of the 3rd
+    file.open(QIODevice::WriteOnly);
+    file.write(input.left(consts::MIN_CHUNK_SIZE * 2 + 100));
+    file.close();
+
+    journal           = Journal();
+    journal.path      = journalPath;
+    journal.direction = false;
+    journal.output    = QFileInfo("resume.bin").absoluteFilePath();
+    journal.chunks    = 2;
+    journal.setSource(QFileInfo("resume.bin.arsn"));
+    if (!arsn.seek(dataStart) || !ChunkPipeline::replayTags(arsn, 2, header.chunkSize, false, journal.state))
+        return (false);
+    arsn.close();
+    journal.save();
+
+    Crypto.setParam(false, QStringList{"resume.bin.arsn"}, "mypassword", 0, 0, true);
+    Crypto.start();
+    Crypto.wait();
+
+    if (QFile::exists(journalPath) || QFile::exists("resume.bin.arsn") || QFile::exists("resume (2).bin"))
+        return (false);
+    if (!file.open(QIODevice::ReadOnly) || file.readAll() != input)
+        return (false);
+    return (file.remove());
+}
+
+bool inspectHeaders()
+{
+    Botan::AutoSeeded_RNG rng;
+    const auto clear = rng.random_vec(consts::MIN_CHUNK_SIZE * 3 + 77);
+
+    QFile::remove("inspect.bin.arsn");
+    QFile file("inspect.bin");
+    file.open(QIODevice::WriteOnly);
+    file.write(reinterpret_cast<const char*>(clear.data()), clear.size());
+    file.close();
+
+    Crypto_Thread Crypto;
+    Crypto.setParam(true, QStringList{"inspect.bin"}, "mypassword", 0, 0, true);
+    Crypto.setChunkSize(consts::MIN_CHUNK_SIZE);
+    Crypto.start();
+    Crypto.wait();
+
+    auto inspection = Inspection::inspect("inspect.bin.arsn");
+    if (inspection.status != DECRYPT_SUCCESS || !inspection.problems.isEmpty())
+        return (false);
+    if (inspection.chunks != 4 || inspection.header.fileSize != static_cast<qint64>(clear.size()))
+        return (false);
+
+    // a cut file is reported, not rejected
+    QFile arsn("inspect.bin.arsn");
+    arsn.resize(inspection.size - 10);
+    inspection = Inspection::inspect("inspect.bin.arsn");
+    if (inspection.status != DECRYPT_SUCCESS || inspection.problems.isEmpty())
+        return (false);
+
+    // the plaintext is not an .arsn file
+    file.open(QIODevice::WriteOnly);
+    file.write(reinterpret_cast<const char*>(clear.data()), clear.size());
+    file.close();
+    if (Inspection::inspect("inspect.bin").status != NOT_AN_ARSENIC_FILE)
+        return (false);
+
+    return (arsn.remove() && file.remove());
+}
+
+bool jobSchedulerVisitsEveryFile()
+{
+    // 1 large file and 100 small ones, in any order on the command line
+    QStringList files;
+    for (auto i = 0; i < 101; ++i) {
+        const auto name = QString("job%1.bin").arg(i);
+        QFile file(QDir::cleanPath(name));
+        file.open(QIODevice::WriteOnly);
+        file.write(QByteArray(i == 50 ? 4096 : i, 'x'));
+        files << name;
+    }
+
+    JobScheduler scheduler(4, 8);
+    scheduler.setLargeFileSize(4096);
+
+    std::mutex mutex;
+    QMap<QString, quint32> seen;
+    QStringList failed;
+    auto duplicates = 0;
+    scheduler.setErrorCallback([&](const QString &path, const QString &) {
+        std::lock_guard<std::mutex> lock(mutex);
+        failed << path;
+    });
+    // a file throwing on a pool thread fails alone, the others still go
+    scheduler.run(files, [&](const QString &path, quint32 chunkThreads) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (seen.contains(path))
+                ++duplicates;
+            seen[path] = chunkThreads;
+        }
+        if (path == "job7.bin")
+            throw std::bad_alloc();
+    });
+
+    if (duplicates > 0 || seen.size() != files.size() || failed != (QStringList() << "job7.bin"))
+        return (false);
+    for (const auto &name : files) {
+        if (seen.value(name) != (name == "job50.bin" ? 8u : 1u))
+            return (false);
+        QFile::remove(QDir::cleanPath(name));
+    }
+
+    // largest first
+    const auto jobs = JobScheduler::order(files.mid(48, 4));
+    return (jobs.first().path == "job50.bin" && jobs.last().path == "job48.bin");
+}
+
+bool keyCacheDerivesOnce()
+{
+    Botan::AutoSeeded_RNG rng;
+    const auto salt = rng.random_vec(consts::ARGON_SALT_LEN);
+
+    // the same key wanted by four files at once
+    KeyCache cache;
+    std::vector<Botan::SecureVector<quint8>> keys(4);
+    std::vector<std::thread> threads;
+    for (auto i = 0; i < 4; ++i)
+        threads.emplace_back([&, i] { keys[i] = cache.key("mypassword", salt, 8192, 1, 1); });
+    for (auto &thread : threads)
+        thread.join();
+
+    if (cache.derivations() != 1 || !cache.contains(salt, 8192, 1, 1))
+        return (false);
+    for (const auto &key : keys) {
+        if (key != keys.front())
+            return (false);
+    }
+
+    cache.clear();
+    return (!cache.contains(salt, 8192, 1, 1));
+}
+
+bool encryptFileMapped()
+{
+    Botan::AutoSeeded_RNG rng;
+    const auto clear = rng.random_vec(consts::IN_BUFFER_SIZE * 4 + 777);
+    const QByteArray expected(reinterpret_cast<const char*>(clear.data()), clear.size());
+
+    QFile::remove(QDir::cleanPath("mapped.bin"));
+    QFile::remove(QDir::cleanPath("mapped.bin.arsn"));
+
+    QFile src_file(QDir::cleanPath("mapped.bin"));
+    src_file.open(QIODevice::WriteOnly);
+    src_file.write(expected);
+    src_file.close();
+
+    // the original is deleted after encryption and the .arsn after decryption
+    Crypto_Thread Crypto;
+    Crypto.setMemoryMapped(true);
+    Crypto.setChunkSize(consts::MIN_CHUNK_SIZE * 2);
+    Crypto.setParam(true, QStringList() << "mapped.bin", "mypassword", 0, 0, true);
+    Crypto.start();
+    Crypto.wait();
+    if (!Crypto.mapped())
+        return (false);
+
+    Crypto.setParam(false, QStringList() << "mapped.bin.arsn", "mypassword", 0, 0, true);
+    Crypto.start();
+    Crypto.wait();
+    if (!Crypto.mapped())
+        return (false);
+
+    QFile des_file(QDir::cleanPath("mapped.bin"));
+    if (!des_file.open(QIODevice::ReadOnly))
+        return (false);
+
+    return (des_file.readAll() == expected);
+}
+
+bool directIoEncryption()
+{
+    // a DirectFile written and read back from an offset inside a block
+    Botan::AutoSeeded_RNG rng;
+    const auto clear = rng.random_vec(consts::DIRECT_IO_BUFFER * 2 + 777);
+    const QByteArray expected(reinterpret_cast<const char*>(clear.data()), clear.size());
+
+    QFile file(QDir::cleanPath("direct.bin"));
+    file.open(QIODevice::WriteOnly);
+    file.write("header");
+    file.close();
+
+    DirectFile output(file.fileName(), 6);
+    if (output.open(QIODevice::WriteOnly)) {
+        output.write(expected.constData(), 100);
+        output.write(expected.constData() + 100, expected.size() - 100);
+        output.close();
+        if (output.failed() || output.position() != expected.size() + 6 || file.size() != expected.size() + 6)
+            return (false);
+
+        DirectFile input(file.fileName(), 6);
+        if (!input.open(QIODevice::ReadOnly) || input.readAll() != expected)
+            return (false);
+        input.close();
+    }
+    else {
+        // tmpfs, overlayfs: the pipeline below takes the cache with hints
+        WARN("O_DIRECT refused here, only the page cache fallback is tested");
+    }
+
+    // the fallback: written pages are synced and dropped, none is lost
+    file.open(QIODevice::ReadWrite | QIODevice::Truncate);
+    DirectFile::adviseSequential(file);
+    file.write(expected);
+    DirectFile::dropCache(file, 0, expected.size());
+    file.close();
+    if (!file.open(QIODevice::ReadOnly) || file.readAll() != expected)
+        return (false);
+    file.close();
+
+    // the pipeline around the page cache, or through it with the hints where
+    // the file system refuses: the .arsn decrypts back the same either way
+    Crypto_Thread Crypto;
+    Crypto.setDirectIo(true);
+    Crypto.setChunkSize(consts::MIN_CHUNK_SIZE);
+    Crypto.setParam(true, QStringList() << "direct.bin", "mypassword", 0, 0, true);
+    Crypto.start();
+    Crypto.wait();
+
+    Crypto.setParam(false, QStringList() << "direct.bin.arsn", "mypassword", 0, 0, true);
+    Crypto.start();
+    Crypto.wait();
+
+    if (QFile::exists("direct.bin.arsn") || !file.open(QIODevice::ReadOnly) || file.readAll() != expected)
+        return (false);
+    return (file.remove());
+}
+
+bool ioEngineBackends()
+{
+    // blocks written out of order and read back, with both backends
+    Botan::AutoSeeded_RNG rng;
+    const qint64 blockSize = 65536 + 13;
+    const auto clear       = rng.random_vec(blockSize * 40);
+
+    for (const auto uring : {true, false}) {
+        QFile file(QDir::cleanPath("ioengine.bin"));
+        if (!file.open(QIODevice::ReadWrite | QIODevice::Truncate))
+            return (false);
+
+        IoEngine engine(8, uring);
+        if (!uring && engine.backend() != IoEngine::THREADS)
+            return (false);
+
+        quint64 submitted = 0;
+        while (submitted < 40 || engine.inFlight() > 0) {
+            while (submitted < 40 && engine.inFlight() < engine.depth()) {
+                const auto block = (submitted * 7) % 40;
+                IoRequest request{file.handle(), true, const_cast<quint8 *>(clear.data()) + block * blockSize, blockSize, static_cast<qint64>(block) * blockSize, block};
+                if (!engine.submit(request))
+                    return (false);
+                ++submitted;
+            }
+            IoCompletion completion;
+            if (!engine.complete(completion) || completion.result != blockSize)
+                return (false);
+        }
+
+        // a read past the end stops short, polled without waiting
+        Botan::SecureVector<quint8> back(clear.size() + 100);
+        IoCompletion completion;
+        if (engine.tryComplete(completion) || !engine.submit(IoRequest{file.handle(), false, back.data(), static_cast<qint64>(back.size()), 0, 0}))
+            return (false);
+        while (!engine.tryComplete(completion))
+            std::this_thread::yield();
+        if (engine.inFlight() != 0)
+            return (false);
+        if (completion.result != static_cast<qint64>(clear.size()) || !std::equal(clear.begin(), clear.end(), back.begin()))
+            return (false);
+        file.remove();
+    }
+    return (true);
+}
+
+bool asyncIoEncryption()
+{
+    Botan::AutoSeeded_RNG rng;
+    const auto clear = rng.random_vec(consts::MIN_CHUNK_SIZE * 37 + 5);
+    const QByteArray expected(reinterpret_cast<const char*>(clear.data()), clear.size());
+
+    QFile file(QDir::cleanPath("async.bin"));
+    file.open(QIODevice::WriteOnly);
+    file.write(expected);
+    file.close();
+
+    // the .arsn is the same as with blocking calls, the key and nonces are
+    // fixed by the header
+    Crypto_Thread Crypto;
+    Crypto.setIoDepth(4);
+    Crypto.setChunkSize(consts::MIN_CHUNK_SIZE);
+    Crypto.setParam(true, QStringList() << "async.bin", "mypassword", 0, 0, true);
+    Crypto.start();
+    Crypto.wait();
+
+    Crypto.setParam(false, QStringList() << "async.bin.arsn", "mypassword", 0, 0, true);
+    Crypto.start();
+    Crypto.wait();
+
+    if (QFile::exists("async.bin.arsn") || !file.open(QIODevice::ReadOnly) || file.readAll() != expected)
+        return (false);
+    return (file.remove());
+}
+
+bool spscRingOrder()
+{
+    // a ring much smaller than the items, so both sides wrap many times
+    SpscRing<Botan::SecureVector<quint8>> ring(3);
+    const quint32 count = 200000;
+    std::thread producer([&] {
+        for (quint32 i = 0; i < count;) {
+            Botan::SecureVector<quint8> item(i % 97 + 1, static_cast<quint8>(i));
+            if (ring.tryPush(std::move(item)))
+                ++i;
+            else
+                std::this_thread::yield();
+        }
+    });
+
+    auto ordered = true;
+    Botan::SecureVector<quint8> item;
+    for (quint32 next = 0; next < count;) {
+        if (!ring.tryPop(item)) {
+            std::this_thread::yield();
+            continue;
+        }
+        ordered &= item.size() == next % 97 + 1 && item[0] == static_cast<quint8>(next);
+        ++next;
+    }
+    producer.join();
+    return (ordered && !ring.tryPop(item));
+}
+
+bool mpmcRingStress()
+{
+    // every value pushed by 4 producers is popped once by 4 consumers, and
+    // the values of a producer come out in order for each consumer
+    const quint64 perProducer = 50000;
+    for (const size_t capacity : {1, 2, 7, 64}) {
+        ChunkQueue<quint64> queue(capacity);
+        std::atomic<quint64> sum{0};
+        std::atomic<quint64> popped{0};
+        std::atomic<bool> ordered{true};
+        std::vector<std::thread> producers;
+        std::vector<std::thread> consumers;
+        for (quint64 p = 0; p < 4; ++p) {
+            producers.emplace_back([&, p] {
+                for (quint64 i = 1; i <= perProducer; ++i) {
+                    auto value = p << 32 | i;
+                    if (!queue.push(std::move(value)))
+                        ordered = false;
+                }
+            });
+        }
+        for (int c = 0; c < 4; ++c) {
+            consumers.emplace_back([&] {
+                quint64 last[4] = {0, 0, 0, 0};
+                quint64 value;
+                while (queue.pop(value)) {
+                    const auto p = value >> 32;
+                    const auto i = value & 0xffffffff;
+                    if (p >= 4 || i <= last[p])
+                        ordered = false;
+                    else
+                        last[p] = i;
+                    sum += i;
+                    ++popped;
+                }
+            });
+        }
+        for (auto &thread : producers)
+            thread.join();
+        queue.close();
+        for (auto &thread : consumers)
+            thread.join();
+
+        // closed: pushing fails, popping an empty queue doesn't block
+        quint64 value = 0;
+        if (!ordered || popped != perProducer * 4 || sum != 4 * perProducer * (perProducer + 1) / 2 || queue.push(std::move(value)) || queue.pop(value))
+            return (false);
+    }
+    return (true);
+}
+
+bool inputLimit()
+{
+    // blocks followed by other data, as in an archive: the last block is
+    // short and must not take the bytes after it, on every read path
+    Botan::AutoSeeded_RNG rng;
+    const auto key         = rng.random_vec(consts::CIPHER_KEY_LEN * 3);
+    const auto tripleNonce = rng.random_vec(consts::CIPHER_IV_LEN * 3);
+    const auto clear       = rng.random_vec(consts::IN_BUFFER_SIZE * 3 + 8999);
+    QByteArray input(reinterpret_cast<const char*>(clear.data()), clear.size());
+
+    QByteArray encrypted;
+    QBuffer src(&input);
+    QBuffer des(&encrypted);
+    src.open(QIODevice::ReadOnly);
+    des.open(QIODevice::WriteOnly);
+    ChunkPipeline encryption(true, key, 2);
+    if (encryption.run(src, des, tripleNonce) != CRYPT_SUCCESS)
+        return (false);
+    const auto dataEnd = 6 + encrypted.size();
+
+    QFile file(QDir::cleanPath("limited.bin"));
+    if (!file.open(QIODevice::WriteOnly))
+        return (false);
+    file.write("header");
+    file.write(encrypted);
+    file.write(QByteArray(100, 'x'));
+    file.close();
+
+    for (const auto path : {0, 1, 2}) {
+        QFile src_file(file.fileName());
+        QFile des_file(QDir::cleanPath("limited.out"));
+        if (!src_file.open(QIODevice::ReadOnly) || !src_file.seek(6) || !des_file.open(QIODevice::ReadWrite | QIODevice::Truncate))
+            return (false);
+
+        ChunkPipeline decryption(false, key, 2);
+        decryption.setMemoryMapped(path == 1);
+        decryption.setIoDepth(path == 2 ? 4 : 0);
+        decryption.setInputLimit(dataEnd);
+        if (decryption.run(src_file, des_file, tripleNonce) != DECRYPT_SUCCESS || decryption.mapped() != (path == 1))
+            return (false);
+        des_file.seek(0);
+        if (des_file.readAll() != input)
+            return (false);
+        des_file.remove();
+    }
+    return (file.remove());
+}
+
+bool memoryBudget()
+{
+    Botan::AutoSeeded_RNG rng;
+    const auto key         = rng.random_vec(consts::CIPHER_KEY_LEN * 3);
+    const auto tripleNonce = rng.random_vec(consts::CIPHER_IV_LEN * 3);
+    const auto clear       = rng.random_vec(consts::IN_BUFFER_SIZE * 20 + 77);
+    const quint64 budget   = (consts::IN_BUFFER_SIZE + consts::MACBYTES * 3) * 3;
+
+    // 8 workers would take 32 buffers, the budget only allows 3
+    QByteArray input(reinterpret_cast<const char*>(clear.data()), clear.size());
+    QByteArray encrypted;
+    QBuffer src(&input);
+    QBuffer des(&encrypted);
+    src.open(QIODevice::ReadOnly);
+    des.open(QIODevice::WriteOnly);
+    ChunkPipeline encryption(true, key, 8);
+    encryption.setMemoryBudget(budget);
+    if (encryption.memoryUsage() > budget || encryption.run(src, des, tripleNonce) != CRYPT_SUCCESS || encryption.poolBuffers() != 3)
+        return (false);
+
+    // never less than a buffer being read and one being written
+    QByteArray decrypted;
+    QBuffer src2(&encrypted);
+    QBuffer des2(&decrypted);
+    src2.open(QIODevice::ReadOnly);
+    des2.open(QIODevice::WriteOnly);
+    ChunkPipeline decryption(false, key, 8);
+    decryption.setMemoryBudget(1);
+    if (decryption.run(src2, des2, tripleNonce) != DECRYPT_SUCCESS || decryption.poolBuffers() != 2)
+        return (false);
+
+    ChunkPipeline unlimited(true, key, 8);
+    unlimited.setMemoryBudget(0);
+    return (decrypted == input && unlimited.memoryUsage() == budget / 3 * 32);
+}
+
+bool fusedCascadeMatchesThreePasses()
+{
+    Botan::AutoSeeded_RNG rng;
+    const auto key   = rng.random_vec(consts::CIPHER_KEY_LEN * 3);
+    const auto nonce = rng.random_vec(consts::CIPHER_IV_LEN * 3);
+
+    // the cascade as three full-buffer passes
+    auto chacha  = Botan::AEAD_Mode::create("ChaCha20Poly1305", Botan::ENCRYPTION);
+    auto aes     = Botan::AEAD_Mode::create("AES-256/EAX", Botan::ENCRYPTION);
+    auto serpent = Botan::AEAD_Mode::create("Serpent/GCM", Botan::ENCRYPTION);
+    chacha->set_key(key.data(), consts::CIPHER_KEY_LEN);
+    aes->set_key(key.data() + consts::CIPHER_KEY_LEN, consts::CIPHER_KEY_LEN);
+    serpent->set_key(key.data() + consts::CIPHER_KEY_LEN * 2, consts::CIPHER_KEY_LEN);
+
+    // around the sub-block size of the fused kernel
+    const size_t sizes[] = {0, 1, 63, consts::CASCADE_BLOCK_SIZE - 1, consts::CASCADE_BLOCK_SIZE, consts::CASCADE_BLOCK_SIZE + 1,
+                            consts::CASCADE_BLOCK_SIZE * 3, consts::CASCADE_BLOCK_SIZE * 3 + 48, consts::IN_BUFFER_SIZE + 17};
+
+    for (const auto size : sizes) {
+        const auto clear = rng.random_vec(size);
+
+        // nonces are incremented once before the first chunk
+        auto ivs = nonce;
+        for (auto i = 0; i < 3; ++i)
+            Botan::Sodium::sodium_increment(ivs.data() + i * consts::CIPHER_IV_LEN, consts::CIPHER_IV_LEN);
+
+        auto expected = clear;
+        chacha->start(ivs.data(), consts::CIPHER_IV_LEN);
+        chacha->finish(expected);
+        aes->start(ivs.data() + consts::CIPHER_IV_LEN, consts::CIPHER_IV_LEN);
+        aes->finish(expected);
+        serpent->start(ivs.data() + consts::CIPHER_IV_LEN * 2, consts::CIPHER_IV_LEN);
+        serpent->finish(expected);
+
+        CryptoEngine encrypt(true);
+        encrypt.setKey(key);
+        encrypt.setNonce(nonce);
+        auto buffer = clear;
+        encrypt.finish(buffer);
+        if (buffer != expected)
+            return (false);
+
+        CryptoEngine decrypt(false);
+        decrypt.setKey(key);
+        decrypt.setNonce(nonce);
+        decrypt.finish(buffer);
+        if (buffer != clear)
+            return (false);
+    }
+    return (true);
+}
+
+bool parallelArgonMatchesBotan()
+{
+    Botan::AutoSeeded_RNG rng;
+    const auto salt     = rng.random_vec(consts::ARGON_SALT_LEN);
+    const char secret[] = "correct horse battery staple";
+    auto family         = Botan::PasswordHashFamily::create_or_throw("Argon2id");
+
+    // 4096 KiB is enough for several address blocks per segment
+    for (const quint32 lanes : {1, 2, 4, 7}) {
+        Botan::SecureVector<quint8> expected(consts::CIPHER_KEY_LEN * 3);
+        family->from_params(4096, 2, lanes)->derive_key(expected.data(), expected.size(), secret, sizeof(secret) - 1, salt.data(), salt.size());
+
+        for (const quint32 threads : {1u, 3u, 0u}) {
+            Botan::SecureVector<quint8> key(expected.size());
+            Argon2id::derive(key.data(), key.size(), secret, sizeof(secret) - 1, salt.data(), salt.size(), 4096, 2, lanes, threads);
+            if (key != expected)
+                return (false);
+        }
+    }
+    return (true);
+}
+
+bool argonCalibration()
+{
+    // a target nobody can reach keeps the interactive preset
+    ArgonCalibration fast(1);
+    const auto floor = fast.calibrate();
+    if (floor.memlimit != consts::MEMLIMIT_INTERACTIVE || floor.iterations != consts::ITERATION_INTERACTIVE)
+        return (false);
+
+    // a capped run never goes over the cap, and only keeps what fits
+    ArgonCalibration capped(60000);
+    capped.setMaxMemlimit(consts::MEMLIMIT_INTERACTIVE * 2);
+    const auto result = capped.calibrate();
+    if (result.memlimit > consts::MEMLIMIT_INTERACTIVE * 2 || result.milliseconds > 60000)
+        return (false);
+
+    return (capped.toJson()["result"].toObject()["memlimit_kib"].toInt() == static_cast<int>(result.memlimit));
+}
+
 QString upper(QString str)
 {
     return (str.toUpper());
@@ -125,6 +1437,138 @@ TEST_CASE("File Encryption / decryption ", "[single - file] ")
 {
     REQUIRE(encryptFile() == true);
 }
+TEST_CASE("Parallel chunk encryption matches the serial loop ", "[single - file] ")
+{
+    REQUIRE(parallelMatchesSerial() == true);
+}
+TEST_CASE("Parallel chunk decryption and tag failure ", "[single - file] ")
+{
+    REQUIRE(parallelDecryption() == true);
+}
+TEST_CASE("Seek to a chunk index matches replaying the nonces ", "[single - file] ")
+{
+    REQUIRE(seekMatchesReplay() == true);
+}
+TEST_CASE("Decryption of a byte range ", "[single - file] ")
+{
+    REQUIRE(decryptRange() == true);
+}
+TEST_CASE("Batch encryption runs Argon2 once ", "[single - file] ")
+{
+    REQUIRE(batchEncryption() == true);
+}
+TEST_CASE("Decryption uses the Argon2 parameters of the file ", "[single - file] ")
+{
+    REQUIRE(storedArgonParameters() == true);
+}
+TEST_CASE("Encryption uses the calibrated Argon2 parameters ", "[single - file] ")
+{
+    REQUIRE(calibratedArgonParameters() == true);
+}
+
+TEST_CASE("Directory tree Encryption / decryption ", "[single - file] ")
+{
+    REQUIRE(directoryEncryption() == true);
+}
+TEST_CASE("Archive Encryption / extraction ", "[single - file] ")
+{
+    REQUIRE(archiveEncryption() == true);
+}
+TEST_CASE("Padded and legacy name blocks ", "[single - file] ")
+{
+    REQUIRE(nameBlockLayouts() == true);
+}
+TEST_CASE("Pre 4.1.0 header without chunk size, lanes and key mode ", "[single - file] ")
+{
+    REQUIRE(legacyHeader() == true);
+}
+TEST_CASE("Adaptive chunk size bounds ", "[single - file] ")
+{
+    REQUIRE(adaptiveChunkBounds() == true);
+}
+TEST_CASE("Concurrent outputs get distinct names ", "[single - file] ")
+{
+    REQUIRE(uniqueOutputNames() == true);
+}
+TEST_CASE("Stream Encryption / decryption ", "[single - file] ")
+{
+    REQUIRE(streamEncryption() == true);
+}
+
+TEST_CASE("Compressed Encryption / decryption ", "[single - file] ")
+{
+    REQUIRE(compressedEncryption() == true);
+}
+
+TEST_CASE("Interrupted jobs resume from their journal ", "[single - file] ")
+{
+    REQUIRE(resumeJob() == true);
+}
+
+TEST_CASE("Headers are inspected without the passphrase ", "[single - file] ")
+{
+    REQUIRE(inspectHeaders() == true);
+}
+
+TEST_CASE("Job scheduler hands every file out once ", "[single - file] ")
+{
+    REQUIRE(jobSchedulerVisitsEveryFile() == true);
+}
+TEST_CASE("Key cache derives a shared key once ", "[single - file] ")
+{
+    REQUIRE(keyCacheDerivesOnce() == true);
+}
+TEST_CASE("Memory mapped file Encryption / decryption ", "[single - file] ")
+{
+    REQUIRE(encryptFileMapped() == true);
+}
+
+TEST_CASE("Direct I/O file Encryption / decryption ", "[single - file] ")
+{
+    REQUIRE(directIoEncryption() == true);
+}
+
+TEST_CASE("Asynchronous I/O engine backends ", "[single - file] ")
+{
+    REQUIRE(ioEngineBackends() == true);
+}
+
+TEST_CASE("Asynchronous I/O file Encryption / decryption ", "[single - file] ")
+{
+    REQUIRE(asyncIoEncryption() == true);
+}
+
+TEST_CASE("Blocks followed by other data ", "[single - file] ")
+{
+    REQUIRE(inputLimit() == true);
+}
+
+TEST_CASE("Chunk buffers within the memory budget ", "[single - file] ")
+{
+    REQUIRE(memoryBudget() == true);
+}
+
+TEST_CASE("Single producer ring keeps the order ", "[single - file] ")
+{
+    REQUIRE(spscRingOrder() == true);
+}
+
+TEST_CASE("Multi producer ring queue under contention ", "[single - file] ")
+{
+    REQUIRE(mpmcRingStress() == true);
+}
+TEST_CASE("Fused cascade matches three full passes ", "[single - file] ")
+{
+    REQUIRE(fusedCascadeMatchesThreePasses() == true);
+}
+TEST_CASE("Parallel Argon2id lanes match Botan ", "[single - file] ")
+{
+    REQUIRE(parallelArgonMatchesBotan() == true);
+}
+TEST_CASE("Argon2 calibration ", "[single - file] ")
+{
+    REQUIRE(argonCalibration() == true);
+}
 TEST_CASE("String Encryption / decryption ", "[single - file] ")
 {
     REQUIRE(encryptString() == true);